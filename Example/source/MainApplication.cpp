@@ -1,10 +1,58 @@
 #include <MainApplication.hpp>
+#include <chrono>
 
 // Implement all the layout/application functions here
 
+namespace {
+
+    // Small benchmark of Plutonium's job system (the worker pool used for background work), submitting lots of tiny jobs
+    constexpr u32 BenchmarkJobCount = 5000;
+
+    std::string RunJobBenchmark() {
+        const std::pair<pu::jobs::JobPriority, const char*> priorities[] = {
+            { pu::jobs::JobPriority::Low, "Low" },
+            { pu::jobs::JobPriority::Normal, "Normal" },
+            { pu::jobs::JobPriority::High, "High" }
+        };
+
+        std::string report = std::to_string(BenchmarkJobCount) + " jobs on " + std::to_string(pu::jobs::GetWorkerCount()) + " workers each:\n";
+        std::vector<pu::jobs::JobHandle> handles;
+        handles.reserve(BenchmarkJobCount);
+        for(const auto &[prio, prio_name] : priorities) {
+            // Every other job does a little work, the rest are empty, to measure the per-job overhead
+            std::atomic<u32> sum = 0;
+            pu::jobs::ResetStatistics();
+            const auto start_time = std::chrono::steady_clock::now();
+            for(u32 i = 0; i < BenchmarkJobCount; i++) {
+                if(i % 2) {
+                    handles.push_back(pu::jobs::Submit([&sum, i]() {
+                        for(u32 j = 0; j < 100; j++) {
+                            sum += i ^ j;
+                        }
+                    }, {}, prio));
+                }
+                else {
+                    handles.push_back(pu::jobs::Submit([]() {}, {}, prio));
+                }
+            }
+            for(const auto &handle : handles) {
+                handle.Wait();
+            }
+            const auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+            handles.clear();
+
+            const auto stats = pu::jobs::GetStatistics();
+            const auto jobs_per_s = (elapsed_us > 0) ? (BenchmarkJobCount * 1000000ull / elapsed_us) : 0;
+            report += std::string(prio_name) + ": " + std::to_string(jobs_per_s) + " jobs/s, queue latency " + std::to_string(stats.GetAverageQueueLatencyUs()) + " us average, " + std::to_string(stats.max_queue_latency_us) + " us max\n";
+        }
+        return report;
+    }
+
+}
+
 CustomLayout::CustomLayout() : Layout::Layout() {
     // Create the TextBlock instance with the text we want
-    this->helloText = pu::ui::elm::TextBlock::New(300, 300, "Press X to answer my question");
+    this->helloText = pu::ui::elm::TextBlock::New(300, 300, "Press X to answer my question, or Y to benchmark the job system");
     
     // Add the instance to the layout. IMPORTANT! this MUST be done for them to be used, having them as members is not enough (just a simple way to keep them)
     this->Add(this->helloText);
@@ -45,6 +93,10 @@ void MainApplication::OnLoad() {
                 }
             }
         }
+        // If Y is pressed, benchmark the job system and show the results
+        else if(keys_down & HidNpadButton_Y) {
+            this->CreateShowDialog("Job system benchmark", RunJobBenchmark(), { "Ok" }, true);
+        }
         // If + is pressed, exit application
         else if(keys_down & HidNpadButton_Plus) {
             this->Close();
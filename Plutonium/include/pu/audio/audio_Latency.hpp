@@ -0,0 +1,45 @@
+
+/*
+
+    Plutonium library
+
+    @file audio_Latency.hpp
+    @brief Measurement of the latency between playing sounds and the mixer picking them up
+    @author XorTroll
+
+    @copyright Plutonium project - an easy-to-use UI framework for Nintendo Switch homebrew
+
+*/
+
+#pragma once
+#include <SDL2/SDL_mixer.h>
+#include <pu/pu_Include.hpp>
+
+namespace pu::audio {
+
+    struct LatencyStatistics {
+        u64 measured_count;
+        // Time between a sound being played and the first mixer callback mixing it
+        u64 min_us;
+        u64 max_us;
+        u64 total_us;
+        // What the mixer buffer (as obtained from the device) adds on top of that before the sound is actually heard
+        u64 buffer_us;
+
+        inline u64 GetAverageUs() const {
+            return (this->measured_count > 0) ? (this->total_us / this->measured_count) : 0;
+        }
+    };
+
+    // Takes over SDL_mixer's post-mix callback while enabled, audio needs to be initialized already
+    void EnableLatencyMeasurement();
+    void DisableLatencyMeasurement();
+    bool IsLatencyMeasurementEnabled();
+
+    // Same as Mix_PlayChannel (playing the chunk once), but measured while measurement is enabled
+    i32 PlayChunk(const i32 channel, Mix_Chunk *chunk);
+
+    LatencyStatistics GetLatencyStatistics();
+    void ResetLatencyStatistics();
+
+}
@@ -0,0 +1,116 @@
+
+/*
+
+    Plutonium library
+
+    @file audio_MusicPlayer.hpp
+    @brief Music streamed from a background decoder, with gapless loops and crossfades
+    @author XorTroll
+
+    @copyright Plutonium project - an easy-to-use UI framework for Nintendo Switch homebrew
+
+*/
+
+#pragma once
+#include <SDL2/SDL_mixer.h>
+#include <pu/pu_Include.hpp>
+#include <vector>
+#include <deque>
+#include <atomic>
+
+namespace pu::audio {
+
+    struct MusicPlayerStatistics {
+        // Mixer callbacks which found less decoded audio than they needed while music was playing
+        u64 underrun_count;
+        u64 underrun_sample_count;
+    };
+
+    // Tracks (Ogg Vorbis) are decoded ahead on a dedicated thread into a ring buffer, which the mixer callback just copies from
+    // The player takes over SDL_mixer's music stream (through Mix_HookMusic), so it can't be used along with PlayMusic
+    class MusicPlayer {
+        public:
+            static constexpr u32 DefaultBufferMs = 300;
+
+        private:
+            static constexpr size_t DecoderStackSize = 0x20000;
+            // Above the UI's usual priority, since falling behind is audible while a late frame barely is
+            static constexpr int DecoderPriority = 0x2B;
+            static constexpr u32 DecodeChunkFrameCount = 1024;
+
+            struct Deck;
+
+            struct PlayRequest {
+                std::string path;
+                bool loop;
+                u32 crossfade_ms;
+                bool preload;
+                bool stop;
+            };
+
+            i32 freq;
+            u32 channel_count;
+            bool valid;
+            Thread decoder_thread;
+            bool decoder_running;
+
+            // Written by the decoder and read by the mixer callback, positions are in samples and only ever grow
+            std::vector<s16> ring;
+            std::atomic<u64> ring_write_pos;
+            std::atomic<u64> ring_read_pos;
+            std::atomic<bool> playing;
+            std::atomic<i32> volume;
+            std::atomic<u64> underrun_count;
+            std::atomic<u64> underrun_sample_count;
+
+            // Guards the requests for the decoder
+            Mutex lock;
+            CondVar cond_var;
+            bool decoder_exit;
+            std::deque<PlayRequest> requests;
+
+            // Only touched by the decoder
+            std::vector<std::unique_ptr<Deck>> decks;
+            std::vector<i32> mix_buf;
+
+            static void DecoderMain(void *player_ptr);
+            static void MixCallback(void *player_ptr, u8 *stream, i32 stream_len);
+            void HandleRequest(const PlayRequest &req);
+            void DecodeChunk(const u32 frame_count);
+            void PushRequest(PlayRequest &&req);
+
+        public:
+            // Audio (the mixer) needs to be initialized already
+            MusicPlayer(const u32 buffer_ms = DefaultBufferMs);
+            PU_SMART_CTOR(MusicPlayer)
+            MusicPlayer(const MusicPlayer&) = delete;
+            MusicPlayer &operator=(const MusicPlayer&) = delete;
+            ~MusicPlayer();
+
+            // Only 16-bit mixer output with one or two channels is supported
+            inline bool IsValid() {
+                return this->valid;
+            }
+
+            // Tracks play right after the audio already buffered, fading in while the previous ones fade out if a crossfade is given
+            // Loops are gapless, and preloading reads the whole file into memory first, so that the SD card is never read while playing
+            void Play(const std::string &path, const bool loop = true, const u32 crossfade_ms = 0, const bool preload = false);
+            void Stop(const u32 fade_out_ms = 0);
+
+            inline bool IsPlaying() {
+                return this->playing;
+            }
+
+            inline void SetVolume(const i32 vol) {
+                this->volume = vol;
+            }
+
+            inline i32 GetVolume() {
+                return this->volume;
+            }
+
+            MusicPlayerStatistics GetStatistics();
+            void ResetStatistics();
+    };
+
+}
@@ -0,0 +1,89 @@
+
+/*
+
+    Plutonium library
+
+    @file audio_SfxBank.hpp
+    @brief Preloaded sound effects played on a pool of prioritized voices
+    @author XorTroll
+
+    @copyright Plutonium project - an easy-to-use UI framework for Nintendo Switch homebrew
+
+*/
+
+#pragma once
+#include <SDL2/SDL_mixer.h>
+#include <pu/pu_Include.hpp>
+#include <vector>
+#include <unordered_map>
+
+namespace pu::audio {
+
+    using SfxId = u32;
+    constexpr SfxId InvalidSfxId = UINT32_MAX;
+
+    struct SfxBankStatistics {
+        u64 triggered_count;
+        // Voices cut short to play a sound with higher (or equal) priority
+        u64 stolen_count;
+        // Triggers ignored since every voice was busy with sounds of higher priority
+        u64 dropped_count;
+    };
+
+    // Sounds are decoded (into the mixer's output format) when loaded, so triggering them never allocates nor reads files
+    // Voices are mixer channels reserved for the bank, so sounds played elsewhere (like with PlaySfx) never take them
+    class SfxBank {
+        public:
+            static constexpr u32 DefaultVoiceCount = 8;
+            // Higher priorities win, and may steal voices from lower (or equal) ones
+            static constexpr u8 DefaultPriority = 0x80;
+            static constexpr u8 HighPriority = 0xC0;
+
+        private:
+            struct Sound {
+                Mix_Chunk *chunk;
+                u8 priority;
+            };
+
+            struct Voice {
+                i32 channel;
+                SfxId sfx_id;
+                u8 priority;
+                u64 trigger_seq;
+            };
+
+            std::vector<Sound> sounds;
+            std::unordered_map<std::string, SfxId> sound_table;
+            std::vector<Voice> voices;
+            u64 trigger_seq;
+            SfxBankStatistics stats;
+
+            SfxId AddSound(const std::string &name, Mix_Chunk *chunk, const u8 priority);
+
+        public:
+            SfxBank(const u32 voice_count = DefaultVoiceCount);
+            PU_SMART_CTOR(SfxBank)
+            SfxBank(const SfxBank&) = delete;
+            SfxBank &operator=(const SfxBank&) = delete;
+            ~SfxBank();
+
+            // Loading the same path (or name) again returns the already loaded sound
+            SfxId Load(const std::string &path, const u8 priority = DefaultPriority);
+            // The data (like a file within a sound pack) is only needed while loading
+            SfxId LoadFromMemory(const std::string &name, const void *data, const size_t data_size, const u8 priority = DefaultPriority);
+            SfxId Find(const std::string &path_or_name);
+
+            inline u32 GetVoiceCount() {
+                return this->voices.size();
+            }
+
+            // Returns whether the sound is played, it's dropped if every voice is playing something with higher priority
+            bool Trigger(const SfxId sfx_id, const i32 volume = MIX_MAX_VOLUME);
+            void StopAll();
+
+            inline SfxBankStatistics GetStatistics() {
+                return this->stats;
+            }
+    };
+
+}
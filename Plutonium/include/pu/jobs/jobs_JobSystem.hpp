@@ -0,0 +1,129 @@
+
+/*
+
+    Plutonium library
+
+    @file jobs_JobSystem.hpp
+    @brief Pool of worker threads shared by all background work (text rasterization, decoding, I/O...)
+    @author XorTroll
+
+    @copyright Plutonium project - an easy-to-use UI framework for Nintendo Switch homebrew
+
+*/
+
+#pragma once
+#include <pu/pu_Include.hpp>
+#include <functional>
+#include <atomic>
+
+namespace pu::jobs {
+
+    constexpr u32 DefaultWorkerCount = 2;
+
+    // Workers always take the highest priority job available, stealing from other workers before taking lower priority ones
+    enum class JobPriority : u8 {
+        Low,
+        Normal,
+        High,
+
+        Count
+    };
+
+    using JobFunction = std::function<void()>;
+
+    // Copies share the same flag, so a token can be captured by the job itself to stop early
+    class CancellationToken {
+        private:
+            std::shared_ptr<std::atomic_bool> cancelled;
+
+        public:
+            CancellationToken() : cancelled(std::make_shared<std::atomic_bool>(false)) {}
+
+            inline void Cancel() {
+                *this->cancelled = true;
+            }
+
+            inline bool IsCancelled() const {
+                return *this->cancelled;
+            }
+    };
+
+    class JobHandle {
+        public:
+            enum class Status : u8 {
+                Queued,
+                Running,
+                Done,
+                // Dropped before running, or cancelled while running (the continuation never runs either way)
+                Cancelled
+            };
+
+            struct State {
+                std::atomic<Status> status;
+
+                State() : status(Status::Queued) {}
+            };
+
+        private:
+            std::shared_ptr<State> state;
+            CancellationToken token;
+
+        public:
+            JobHandle() : state(), token() {}
+            JobHandle(std::shared_ptr<State> state, CancellationToken token) : state(state), token(token) {}
+
+            inline Status GetStatus() const {
+                return this->state ? this->state->status.load() : Status::Done;
+            }
+
+            inline bool IsFinished() const {
+                const auto status = this->GetStatus();
+                return (status == Status::Done) || (status == Status::Cancelled);
+            }
+
+            inline void Cancel() {
+                this->token.Cancel();
+            }
+
+            // Shouldn't be called from jobs themselves, since waiting workers don't run other jobs meanwhile
+            void Wait() const;
+    };
+
+    struct JobStatistics {
+        u64 submitted_count;
+        u64 executed_count;
+        // Jobs taken from another worker's queue
+        u64 stolen_count;
+        u64 cancelled_count;
+        // Time between jobs being submitted and a worker starting them
+        u64 max_queue_latency_us;
+        u64 total_queue_latency_us;
+        // Time spent running jobs, summed across all workers
+        u64 total_run_time_us;
+
+        inline u64 GetAverageQueueLatencyUs() const {
+            return (this->executed_count > 0) ? (this->total_queue_latency_us / this->executed_count) : 0;
+        }
+    };
+
+    // Worker threads prefer the cores available to the process other than the one calling this (the UI's)
+    bool Initialize(const u32 worker_count = DefaultWorkerCount);
+    // Waits for running jobs, queued ones are dropped (as cancelled) along with continuations not run yet
+    void Finalize();
+    bool IsInitialized();
+    u32 GetWorkerCount();
+
+    // Can be called from any thread, including from jobs (which queue on their own worker, so other workers steal them if idle)
+    // The continuation runs on the UI thread at the start of the next frame after the job finishes, only if it wasn't cancelled
+    // Without any workers running, the job is run right away on the calling thread
+    JobHandle Submit(JobFunction job_fn, JobFunction cont_fn = {}, const JobPriority prio = JobPriority::Normal, CancellationToken token = {});
+
+    // Runs the function on the UI thread at the start of the next frame, like a continuation
+    void PostToUiThread(JobFunction fn);
+    // Called by Application at the start of every frame
+    void RunContinuations();
+
+    JobStatistics GetStatistics();
+    void ResetStatistics();
+
+}
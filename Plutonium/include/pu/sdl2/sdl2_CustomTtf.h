@@ -89,6 +89,10 @@ extern DECLSPEC TTF_Font * SDLCALL TTF_OpenFont(const char *file, int ptsize);
 extern DECLSPEC TTF_Font * SDLCALL TTF_OpenFontIndex(const char *file, int ptsize, long index);
 extern DECLSPEC TTF_Font * SDLCALL TTF_OpenFontRW(SDL_RWops *src, int freesrc, int ptsize);
 extern DECLSPEC TTF_Font * SDLCALL TTF_OpenFontIndexRW(SDL_RWops *src, int freesrc, int ptsize, long index);
+/* Custom: opens the font in place from memory, which must outlive the font.
+   Fonts opened from the same buffer share a single FreeType face, each with its own size. */
+extern DECLSPEC TTF_Font * SDLCALL TTF_OpenFontMem(const void *mem, size_t size, int ptsize);
+extern DECLSPEC TTF_Font * SDLCALL TTF_OpenFontIndexMem(const void *mem, size_t size, int ptsize, long index);
 
 /* Set and retrieve the font style */
 #define TTF_STYLE_NORMAL        0x00
@@ -153,6 +157,12 @@ extern DECLSPEC int SDLCALL TTF_SizeText(TTF_Font *font, const char *text, int *
 extern DECLSPEC int SDLCALL TTF_SizeUTF8(TTF_Font *font, const char *text, int *w, int *h);
 extern DECLSPEC int SDLCALL TTF_SizeUNICODE(TTF_Font *font, const Uint16 *text, int *w, int *h);
 
+/* Get the dimensions of the first textlen bytes of a UTF-8 string, which doesn't need to be null-terminated */
+extern DECLSPEC int SDLCALL TTF_SizeUTF8_Len(TTF_Font *font, const char *text, size_t textlen, int *w, int *h);
+
+/* Get the dimensions of the surface TTF_RenderUTF8_Blended_Wrapped would create, without rendering anything */
+extern DECLSPEC int SDLCALL TTF_SizeUTF8_Wrapped(TTF_Font *font, const char *text, Uint32 wrapLength, int *w, int *h);
+
 /* Create an 8-bit palettized surface and render the given text at
    fast quality with the given font and color.  The 0 pixel is the
    colorkey, giving a transparent background, and the 1 pixel is set
@@ -252,6 +262,36 @@ extern DECLSPEC int SDLCALL TTF_WasInit(void);
 /* Get the kerning size of two glyphs */
 extern DECLSPEC int TTF_GetFontKerningSize(TTF_Font *font, int prev_index, int index);
 
+/* Custom: load and render a glyph into the font's glyph cache (and the persistent one) ahead of time */
+extern DECLSPEC int TTF_CacheGlyph(TTF_Font *font, Uint16 ch);
+
+/* Custom: identifies a glyph in the persistent glyph cache */
+typedef struct {
+    /* Fingerprint of the font data, computed once when its face is opened */
+    Uint64 src_hash;
+    /* Collections hold several faces in the same data */
+    int face_index;
+    int ptsize;
+    int style;
+    int outline;
+    int hinting;
+    Uint16 ch;
+} TTF_CachedGlyphKey;
+
+/* Custom: metrics and 8-bit pixmap layout of a glyph in the persistent glyph cache */
+typedef struct {
+    Uint32 index;
+    int minx;
+    int maxx;
+    int miny;
+    int maxy;
+    int yoffset;
+    int advance;
+    int width;
+    int rows;
+    int pitch;
+} TTF_CachedGlyphInfo;
+
 /* Code present in C++ code */
 TTF_Font *TTF_CppWrap_FindValidFont(TTF_Font *font, Uint16 ch);
 
@@ -261,6 +301,11 @@ void *TTF_CppWrap_GetCppPtrRef(TTF_Font *font);
 /* Set the pointer to the C++ data */
 void TTF_CppWrap_SetCppPtrRef(TTF_Font *font, void *cpp_ptr_ref);
 
+/* Code present in C++ code: fingerprint font data, look up / add glyphs in the persistent glyph cache */
+Uint64 TTF_CppWrap_ComputeFontHash(const void *src, size_t src_size);
+int TTF_CppWrap_FindCachedGlyph(const TTF_CachedGlyphKey *key, TTF_CachedGlyphInfo *out_info, const Uint8 **out_pixmap);
+void TTF_CppWrap_StoreCachedGlyph(const TTF_CachedGlyphKey *key, const TTF_CachedGlyphInfo *info, const Uint8 *pixmap);
+
 /* We'll use SDL for reporting errors */
 #define TTF_SetError    SDL_SetError
 #define TTF_GetError    SDL_GetError
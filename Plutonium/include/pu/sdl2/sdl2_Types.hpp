@@ -6,6 +6,7 @@
 #include <SDL2/SDL_mixer.h>
 #include <pu/pu_Include.hpp>
 #include <pu/sdl2/sdl2_CustomTtf.h>
+#include <vector>
 
 namespace pu::sdl2 {
 
@@ -16,18 +17,45 @@ namespace pu::sdl2 {
     using Surface = SDL_Surface*;
 
     class TextureHandle {
+        public:
+            struct Level {
+                Texture tex;
+                i32 width;
+                i32 height;
+            };
+
         private:
-            Texture tex;
+            // Dimensions are queried just once, instead of every time the texture is drawn
+            Level base;
+            // Successively smaller copies of the texture, largest first
+            std::vector<Level> mipmaps;
 
         public:
-            constexpr TextureHandle() : tex(nullptr) {}
-            constexpr TextureHandle(Texture tex) : tex(tex) {}
+            TextureHandle() : base({ nullptr, 0, 0 }), mipmaps() {}
+            TextureHandle(Texture tex);
             PU_SMART_CTOR(TextureHandle)
             ~TextureHandle();
 
             inline Texture Get() {
-                return this->tex;
+                return this->base.tex;
+            }
+
+            inline i32 GetWidth() {
+                return this->base.width;
+            }
+
+            inline i32 GetHeight() {
+                return this->base.height;
             }
+
+            void AddMipmap(Texture tex);
+
+            inline bool HasMipmaps() {
+                return !this->mipmaps.empty();
+            }
+
+            // Smallest level still covering the given dimensions, so it's never scaled up nor down by much
+            Texture GetFor(const i32 width, const i32 height);
     };
 
 }
@@ -3,6 +3,9 @@
 #include <pu/sdl2/sdl2_Types.hpp>
 #include <pu/ui/ui_Types.hpp>
 #include <vector>
+#include <array>
+#include <string_view>
+#include <unordered_map>
 
 namespace pu::ttf {
 
@@ -15,16 +18,25 @@ namespace pu::ttf {
                 void *ptr;
                 size_t ptr_sz;
                 FontFaceDisposingFunction dispose_fn;
+                bool open_tried;
 
-                FontFace(void *buf, const size_t buf_size, FontFaceDisposingFunction disp_fn, const u32 font_sz, void *font_class_ptr) : font(nullptr), ptr(buf), ptr_sz(buf_size), dispose_fn(disp_fn) {
-                    this->font = TTF_OpenFontRW(SDL_RWFromMem(this->ptr, this->ptr_sz), 1, font_sz);
-                    if(this->font != nullptr) {
-                        TTF_CppWrap_SetCppPtrRef(this->font, font_class_ptr);
+                // Faces are only registered here, and opened the first time they're actually needed
+                FontFace(void *buf, const size_t buf_size, FontFaceDisposingFunction disp_fn) : font(nullptr), ptr(buf), ptr_sz(buf_size), dispose_fn(disp_fn), open_tried(false) {}
+
+                FontFace() : font(nullptr), ptr(nullptr), ptr_sz(0), dispose_fn(EmptyFontFaceDisposingFunction), open_tried(false) {}
+
+                sdl2::Font Open(const u32 font_sz, void *font_class_ptr) {
+                    if(!this->open_tried) {
+                        this->open_tried = true;
+                        // Opened in place: fonts of every size loaded from the same buffer share a single face
+                        this->font = TTF_OpenFontMem(this->ptr, this->ptr_sz, font_sz);
+                        if(this->font != nullptr) {
+                            TTF_CppWrap_SetCppPtrRef(this->font, font_class_ptr);
+                        }
                     }
+                    return this->font;
                 }
 
-                FontFace() : font(nullptr), ptr(nullptr), ptr_sz(0), dispose_fn(EmptyFontFaceDisposingFunction) {}
-
                 inline bool IsSourceValid() {
                     // AKA - is the base ptr and size valid?
                     return (this->ptr != nullptr) && (this->ptr_sz > 0);
@@ -48,12 +60,35 @@ namespace pu::ttf {
 
             };
 
+            // Codepoint -> font face lookup, split in pages which are only allocated once a codepoint inside them is looked up
+            // Each entry holds the index of the face providing the codepoint plus one, or one of the special values below
+            static constexpr u8 CoverageUnresolved = 0;
+            static constexpr u8 CoverageNotProvided = 0xFF;
+            static constexpr size_t CoveragePageSize = 0x100;
+            static constexpr size_t CoveragePageCount = 0x10000 / CoveragePageSize;
+            using CoveragePage = std::array<u8, CoveragePageSize>;
+
+            // Small direct-mapped memo of measured strings, so measuring the same text again doesn't touch the faces at all
+            static constexpr size_t TextDimensionsCacheSize = 64;
+
+            struct TextDimensionsCacheEntry {
+                bool valid;
+                std::string str;
+                std::pair<u32, u32> dims;
+            };
+
             std::vector<std::pair<i32, std::unique_ptr<FontFace>>> font_faces;
+            std::array<std::unique_ptr<CoveragePage>, CoveragePageCount> coverage_pages;
+            std::array<TextDimensionsCacheEntry, TextDimensionsCacheSize> text_dims_cache;
             u32 font_size;
+            // Held while measuring or rasterizing, so fonts can be used from text render workers too
+            RMutex lock;
+
+            void ResetCaches();
 
             inline sdl2::Font TryGetFirstFont() {
                 if(!this->font_faces.empty()) {
-                    return this->font_faces.begin()->second->font;
+                    return this->font_faces.begin()->second->Open(this->font_size, reinterpret_cast<void*>(this));
                 }
                 return nullptr;
             }
@@ -68,7 +103,9 @@ namespace pu::ttf {
                 return index != InvalidFontFaceIndex;
             }
 
-            Font(const u32 font_sz) : font_size(font_sz) {}
+            Font(const u32 font_sz) : font_faces(), coverage_pages(), text_dims_cache(), font_size(font_sz) {
+                rmutexInit(&this->lock);
+            }
             ~Font();
 
             i32 LoadFromMemory(void *ptr, const size_t size, FontFaceDisposingFunction disp_fn);
@@ -79,9 +116,22 @@ namespace pu::ttf {
                 return this->font_size;
             }
 
+            // Source buffer of the first face in lookup order, opened or not
+            bool GetPrimaryFaceSource(void *&out_ptr, size_t &out_size);
+
             sdl2::Font FindValidFontFor(const Uint16 ch);
-            std::pair<u32, u32> GetTextDimensions(const std::string &str);
-            sdl2::Texture RenderText(const std::string &str, const ui::Color clr);
+            std::pair<u32, u32> GetTextDimensions(const std::string_view &str);
+            // Same as above, but without going through (or filling) the memo, meant for one-off measurements
+            std::pair<u32, u32> ComputeTextDimensions(const std::string_view &str);
+            // Size of the surface rendered with the same wrap width, measured without rasterizing anything
+            std::pair<u32, u32> GetWrappedTextDimensions(const std::string &str, const u32 wrap_width = 0);
+            // Wraps lines at the given width, or at the window's width if zero (see render::GetDefaultWrapWidth)
+            // Rasterizing into a surface can be done from any thread, unlike creating the texture
+            sdl2::Surface RenderTextSurface(const std::string &str, const ui::Color clr, const u32 wrap_width = 0);
+            sdl2::Texture RenderText(const std::string &str, const ui::Color clr, const u32 wrap_width = 0);
     };
 
+    // Total size of the font files currently loaded via Font::LoadFromFile (every file is only kept once in memory)
+    size_t GetLoadedFontFilesSize();
+
 }
@@ -0,0 +1,31 @@
+
+/*
+
+    Plutonium library
+
+    @file ttf_GlyphCache.hpp
+    @brief Optional persistent cache of rendered glyphs, kept in a file across launches
+    @author XorTroll
+
+    @copyright Plutonium project - an easy-to-use UI framework for Nintendo Switch homebrew
+
+*/
+
+#pragma once
+#include <pu/ttf/ttf_Font.hpp>
+
+namespace pu::ttf {
+
+    // Glyphs are keyed by a fingerprint of the font data, the font size, the style and the codepoint
+    // Glyphs rendered while the cache is loaded get added to it (only the charset's, if one is given) up to a fixed size, and saved back to the same file
+
+    bool LoadGlyphCache(const std::string &path, const std::string &charset = "");
+    bool SaveGlyphCache();
+    void DisposeGlyphCache();
+
+    // Renders the (UTF-8) charset's glyphs of the primary face of the given fonts into the cache as low priority jobs
+    // Needs the job system to be running, since doing this on the calling thread would defeat its purpose
+    bool StartGlyphCachePrewarm(const std::vector<std::shared_ptr<Font>> &fonts, const std::string &charset);
+    void StopGlyphCachePrewarm();
+
+}
@@ -0,0 +1,120 @@
+
+/*
+
+    Plutonium library
+
+    @file AnimatedImage.hpp
+    @brief An AnimatedImage is an Element showing an animated picture. (WebP)
+    @author XorTroll
+
+    @copyright Plutonium project - an easy-to-use UI framework for Nintendo Switch homebrew
+
+*/
+
+#pragma once
+#include <pu/ui/elm/elm_Element.hpp>
+#include <chrono>
+#include <array>
+
+struct WebPAnimDecoder;
+
+namespace pu::ui::elm {
+
+    // Frames are decoded on a background thread a few at a time, and shown by updating a single texture
+    // Memory usage only depends on the image's size, not on how many frames it has
+    class AnimatedImage : public Element {
+        public:
+            // Decoded frames waiting to be shown at most
+            static constexpr u32 FrameRingSize = 3;
+
+            // Like browsers do, frames this short (or shorter) are considered unintended and shown for longer
+            static constexpr u64 MinFrameDurationMs = 10;
+            static constexpr u64 DefaultFrameDurationMs = 100;
+
+        private:
+            static constexpr size_t DecoderStackSize = 0x20000;
+            static constexpr int DecoderPriority = 0x2D;
+
+            struct Frame {
+                std::vector<u8> pixels;
+                u64 start_ms;
+            };
+
+            i32 x;
+            i32 y;
+            render::TextureRenderOptions rend_opts;
+            std::vector<u8> img_data;
+            WebPAnimDecoder *decoder;
+            u32 canvas_width;
+            u32 canvas_height;
+            u32 loop_count;
+            u32 frame_count;
+            Thread decoder_thread;
+            bool decoder_running;
+
+            // Guards everything shared with the decoder, below
+            // Only the ring's indices are guarded: slots in the ring are only written by the decoder before they're added,
+            // and only read by the element before they're removed
+            Mutex lock;
+            CondVar cond_var;
+            bool decoder_exit;
+            std::array<Frame, FrameRingSize> frame_ring;
+            u32 frame_ring_start;
+            u32 frame_ring_count;
+
+            // Only touched by the element's thread
+            sdl2::Texture tex;
+            bool started;
+            std::chrono::time_point<std::chrono::steady_clock> start_time;
+
+            static void DecoderMain(void *anim_img_ptr);
+            void UploadFrame(const Frame &frame);
+
+        public:
+            AnimatedImage(const i32 x, const i32 y, const std::string &path);
+            PU_SMART_CTOR(AnimatedImage)
+            ~AnimatedImage();
+
+            inline i32 GetX() override {
+                return this->x;
+            }
+
+            inline void SetX(const i32 x) {
+                this->x = x;
+            }
+
+            inline i32 GetY() override {
+                return this->y;
+            }
+
+            inline void SetY(const i32 y) {
+                this->y = y;
+            }
+
+            inline i32 GetWidth() override {
+                return this->rend_opts.width;
+            }
+
+            inline void SetWidth(const i32 width) {
+                this->rend_opts.width = width;
+            }
+
+            inline i32 GetHeight() override {
+                return this->rend_opts.height;
+            }
+
+            inline void SetHeight(const i32 height) {
+                this->rend_opts.height = height;
+            }
+
+            PU_CLASS_POD_GETSET(RotationAngle, rend_opts.rot_angle, float)
+
+            inline bool IsImageValid() {
+                return this->decoder != nullptr;
+            }
+
+            void OnRender(render::Renderer::Ref &drawer, const i32 x, const i32 y) override;
+            void OnInput(const u64 keys_down, const u64 keys_up, const u64 keys_held, const TouchPoint touch_pos) override {}
+    };
+
+}
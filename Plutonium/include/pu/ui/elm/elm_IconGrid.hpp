@@ -0,0 +1,166 @@
+
+/*
+
+    Plutonium library
+
+    @file IconGrid.hpp
+    @brief An IconGrid is an Element showing a scrollable grid of icons, like a launcher.
+    @author XorTroll
+
+    @copyright Plutonium project - an easy-to-use UI framework for Nintendo Switch homebrew
+
+*/
+
+#pragma once
+#include <pu/ui/elm/elm_Element.hpp>
+#include <pu/jobs/jobs_JobSystem.hpp>
+#include <functional>
+
+namespace pu::ui::elm {
+
+    // Provides the icons of an IconGrid on demand, only for the tiles which are (or are about to be) visible
+    class IconGridDataSource {
+        public:
+            virtual ~IconGridDataSource() {}
+
+            virtual u32 GetItemCount() = 0;
+            // Called from jobs (so possibly from several threads at once), the grid frees the surface afterwards
+            virtual sdl2::Surface LoadItemIcon(const u32 idx) = 0;
+
+            // Called with the pressed keys (or TouchPseudoKey) while the item is selected
+            virtual void OnItemKey(const u32 idx, const u64 keys) {}
+    };
+
+    class IconGrid : public Element {
+        public:
+            static constexpr i32 DefaultTileMargin = 20;
+            static constexpr Color DefaultFocusColor = { 0x00, 0xA0, 0xE6, 0xFF };
+            static constexpr i32 DefaultFocusBorderWidth = 6;
+            static constexpr i32 DefaultFocusBorderRadius = 10;
+
+            static constexpr u32 DefaultPrefetchRowCount = 1;
+            static constexpr u32 DefaultMaxTileLoadsPerFrame = 4;
+
+            // Each frame the scroll offset covers this fraction of the remaining distance
+            static constexpr i32 ScrollSmoothFactor = 4;
+
+            using OnSelectionChangedCallback = std::function<void()>;
+
+            // Shared with the jobs loading tiles, so that the grid can be destroyed while icons are still being loaded
+            struct TileLoadState;
+
+        private:
+            i32 x;
+            i32 y;
+            u32 columns;
+            u32 rows_to_show;
+            i32 tile_size;
+            i32 tile_margin;
+            Color focus_clr;
+            i32 focus_border_width;
+            i32 focus_border_radius;
+            u32 prefetch_row_count;
+            u32 max_tile_loads_per_frame;
+            std::shared_ptr<IconGridDataSource> data_src;
+            OnSelectionChangedCallback on_selection_changed_cb;
+            u32 selected_idx;
+            u32 first_row;
+            i32 scroll_offset;
+            bool item_touched;
+            // Tiles are kept in slots of a single texture, so that all of them are drawn from it in one batch
+            // Items are always loaded in a contiguous window, so item i may simply use slot (i % slot count)
+            sdl2::Texture atlas;
+            std::vector<i32> slot_items;
+            std::shared_ptr<TileLoadState> tile_load_state;
+
+            inline i32 GetTileStride() {
+                return this->tile_size + this->tile_margin;
+            }
+
+            inline u32 GetAtlasRowCount() {
+                // Up to two partially visible rows while scrolling, plus the prefetched ones at each end
+                return this->rows_to_show + 2 + 2 * this->prefetch_row_count;
+            }
+
+            inline u32 GetItemCount() {
+                return (this->data_src != nullptr) ? this->data_src->GetItemCount() : 0;
+            }
+
+            inline SDL_Rect GetSlotRect(const u32 slot) {
+                return { static_cast<i32>(slot % this->columns) * this->tile_size, static_cast<i32>(slot / this->columns) * this->tile_size, this->tile_size, this->tile_size };
+            }
+
+            void ResetAtlas();
+            void ResetSlots();
+            // Returns whether a new load was started, icons are decoded and fitted in a job and only uploaded here
+            bool LoadTile(const u32 idx, const jobs::JobPriority prio);
+            void UploadLoadedTiles();
+            void UpdateTiles();
+            void SetSelectedIndexImpl(const u32 idx);
+
+        public:
+            IconGrid(const i32 x, const i32 y, const u32 columns, const u32 rows_to_show, const i32 tile_size);
+            PU_SMART_CTOR(IconGrid)
+            ~IconGrid();
+
+            inline i32 GetX() override {
+                return this->x;
+            }
+
+            inline void SetX(const i32 x) {
+                this->x = x;
+            }
+
+            inline i32 GetY() override {
+                return this->y;
+            }
+
+            inline void SetY(const i32 y) {
+                this->y = y;
+            }
+
+            inline i32 GetWidth() override {
+                return this->columns * this->GetTileStride() + this->tile_margin;
+            }
+
+            inline i32 GetHeight() override {
+                return this->rows_to_show * this->GetTileStride() + this->tile_margin;
+            }
+
+            PU_CLASS_POD_GET(Columns, columns, u32)
+            void SetColumns(const u32 columns);
+            PU_CLASS_POD_GET(RowsToShow, rows_to_show, u32)
+            void SetRowsToShow(const u32 rows_to_show);
+            PU_CLASS_POD_GET(TileSize, tile_size, i32)
+            void SetTileSize(const i32 tile_size);
+            PU_CLASS_POD_GETSET(TileMargin, tile_margin, i32)
+            PU_CLASS_POD_GETSET(FocusColor, focus_clr, Color)
+            PU_CLASS_POD_GETSET(FocusBorderWidth, focus_border_width, i32)
+            PU_CLASS_POD_GETSET(FocusBorderRadius, focus_border_radius, i32)
+            // Rows loaded beyond each end of the visible ones
+            PU_CLASS_POD_GET(PrefetchRowCount, prefetch_row_count, u32)
+            void SetPrefetchRowCount(const u32 count);
+            // Limits how many icon loads are started in a single frame, spreading the cost of scrolling far away
+            PU_CLASS_POD_GETSET(MaxTileLoadsPerFrame, max_tile_loads_per_frame, u32)
+
+            inline void SetOnSelectionChanged(OnSelectionChangedCallback on_selection_changed_cb) {
+                this->on_selection_changed_cb = on_selection_changed_cb;
+            }
+
+            void SetDataSource(std::shared_ptr<IconGridDataSource> data_src);
+
+            inline std::shared_ptr<IconGridDataSource> GetDataSource() {
+                return this->data_src;
+            }
+
+            // Needed after the data source's contents change, so that icons are loaded again
+            void ForceReloadItems();
+
+            PU_CLASS_POD_GET(SelectedIndex, selected_idx, u32)
+            void SetSelectedIndex(const u32 idx);
+
+            void OnRender(render::Renderer::Ref &drawer, const i32 x, const i32 y) override;
+            void OnInput(const u64 keys_down, const u64 keys_up, const u64 keys_held, const TouchPoint touch_pos) override;
+    };
+
+}
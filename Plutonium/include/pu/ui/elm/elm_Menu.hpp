@@ -15,6 +15,8 @@
 #include <pu/ui/elm/elm_Element.hpp>
 #include <chrono>
 #include <functional>
+#include <deque>
+#include <atomic>
 
 namespace pu::ui::elm {
 
@@ -79,6 +81,96 @@ namespace pu::ui::elm {
             }
     };
 
+    // Provides the rows of a Menu on demand, so that huge lists never need a MenuItem per entry
+    // Only the rows around the visible ones are requested, and kept until they're scrolled away
+    class MenuDataSource {
+        public:
+            virtual ~MenuDataSource() {}
+
+            virtual u32 GetItemCount() = 0;
+            virtual std::string GetItemName(const u32 idx) = 0;
+
+            virtual Color GetItemColor(const u32 idx) {
+                return MenuItem::DefaultColor;
+            }
+
+            virtual sdl2::TextureHandle::Ref GetItemIcon(const u32 idx) {
+                return nullptr;
+            }
+
+            // Called with the pressed keys (or TouchPseudoKey) while the item is selected
+            virtual void OnItemKey(const u32 idx, const u64 keys) {}
+
+            // Called every frame by the menu, for sources whose contents change by themselves
+            // Returns whether they changed, updating the selected index to keep the same item selected if possible
+            virtual bool PollChanges(u32 &selected_idx) {
+                return false;
+            }
+    };
+
+    // The classic MenuItem list, as used by default by every Menu
+    class MenuItemDataSource : public MenuDataSource {
+        public:
+            static constexpr s64 DefaultMergeBudgetUs = 2000;
+
+        private:
+            struct PendingBatch {
+                std::vector<MenuItem::Ref> items;
+                PendingBatch *next;
+            };
+
+            std::vector<MenuItem::Ref> items;
+            // Batches pushed from any thread, newest first, taken all at once by the menu's thread
+            std::atomic<PendingBatch*> pending_batches;
+            // Batches taken but not fully merged yet, oldest first
+            std::deque<std::vector<MenuItem::Ref>> merging_batches;
+            size_t merging_batch_offset;
+            s64 merge_budget_us;
+
+        public:
+            MenuItemDataSource() : items(), pending_batches(nullptr), merging_batches(), merging_batch_offset(0), merge_budget_us(DefaultMergeBudgetUs) {}
+            PU_SMART_CTOR(MenuItemDataSource)
+            ~MenuItemDataSource();
+
+            // Safe to call from any thread (like a background producer enumerating a directory) without locking
+            // Items are appended in the order they were pushed by each thread, when the menu merges them at the start of a frame
+            // Items are only shared with the menu's thread, so they mustn't be modified after being pushed
+            void PushItemBatch(std::vector<MenuItem::Ref> items);
+
+            // Time spent merging pushed items each frame at most, so that huge batches are shown over several frames
+            PU_CLASS_POD_GETSET(MergeBudgetUs, merge_budget_us, s64)
+
+            // Pushed items not merged yet are discarded too (only batches pushed afterwards are merged later)
+            void ClearItems();
+
+            inline bool HasPendingItems() {
+                return !this->merging_batches.empty() || (this->pending_batches.load(std::memory_order_relaxed) != nullptr);
+            }
+
+            inline std::vector<MenuItem::Ref> &GetItems() {
+                return this->items;
+            }
+
+            u32 GetItemCount() override {
+                return this->items.size();
+            }
+
+            std::string GetItemName(const u32 idx) override {
+                return this->items.at(idx)->GetName();
+            }
+
+            Color GetItemColor(const u32 idx) override {
+                return this->items.at(idx)->GetColor();
+            }
+
+            sdl2::TextureHandle::Ref GetItemIcon(const u32 idx) override {
+                return this->items.at(idx)->GetIconTexture();
+            }
+
+            void OnItemKey(const u32 idx, const u64 keys) override;
+            bool PollChanges(u32 &selected_idx) override;
+    };
+
     class Menu : public Element {
         public:
             static constexpr Color DefaultScrollbarColor = { 110, 110, 110, 0xFF };
@@ -99,6 +191,8 @@ namespace pu::ui::elm {
 
             static constexpr s64 DefaultMoveWaitTimeMs = 150;
 
+            static constexpr u32 DefaultPrefetchItemCount = 8;
+
             enum class MoveStatus : u8 {
                 None = 0,
                 WaitingUp = 1,
@@ -112,6 +206,16 @@ namespace pu::ui::elm {
             i32 prev_selected_item_idx;
 
         private:
+            struct LoadedRow {
+                bool valid;
+                std::string name;
+                Color clr;
+                sdl2::TextureHandle::Ref icon;
+                // Only rendered once the row is visible or prefetched, and kept while it stays loaded
+                bool name_requested;
+                std::unique_ptr<render::TextTexture> name_tex;
+            };
+
             i32 x;
             i32 y;
             i32 w;
@@ -130,9 +234,16 @@ namespace pu::ui::elm {
             MoveStatus move_status;
             std::chrono::time_point<std::chrono::steady_clock> move_start_time;
             OnSelectionChangedCallback on_selection_changed_cb;
-            std::vector<MenuItem::Ref> items;
+            std::shared_ptr<MenuItemDataSource> item_src;
+            std::shared_ptr<MenuDataSource> data_src;
+            // Whether rows come from the item list, also checked by PushItemBatch from other threads
+            std::atomic_bool uses_item_src;
+            // Rows around the visible ones starting at this index, slid along as the menu scrolls
+            u32 loaded_rows_start;
+            std::deque<LoadedRow> loaded_rows;
+            u32 prefetch_item_count;
+            bool last_moved_up;
             std::string font_name;
-            std::vector<sdl2::Texture> loaded_name_texs;
             u8 item_alpha_incr_steps;
             float icon_item_sizes_factor;
             u32 icon_margin;
@@ -143,7 +254,10 @@ namespace pu::ui::elm {
             u8 shadow_base_alpha;
             s64 move_wait_time_ms;
 
-            void ReloadItemRenders();
+            void UpdateLoadedRows();
+            void InvalidateLoadedRows();
+            void RequestRowRenders();
+            void ApplyItemChanges(const u32 new_selected_idx);
             void MoveUp();
             void MoveDown();
 
@@ -175,32 +289,30 @@ namespace pu::ui::elm {
             }
 
             inline void RunSelectedItemCallback(const u64 keys) {
-                auto item = this->items.at(this->selected_item_idx);
-                const auto cb_count = item->GetOnKeyCallbackCount();
-                for(u32 i = 0; i < cb_count; i++) {
-                    if(keys & item->GetOnKeyCallbackKey(i)) {
-                        if(!this->cooldown_enabled) {
-                            auto cb = item->GetOnKeyCallback(i);
-                            if(cb) {
-                                cb();
-                            }
-                        }
-                    }
+                // The source may have shrunk since the selection was last updated
+                if((keys != 0) && !this->cooldown_enabled && (this->selected_item_idx < this->GetTotalItemCount())) {
+                    this->data_src->OnItemKey(this->selected_item_idx, keys);
                 }
                 this->cooldown_enabled = false;
             }
 
+            inline u32 GetTotalItemCount() {
+                return this->data_src->GetItemCount();
+            }
+
             inline u32 GetItemCount() {
+                const auto total_item_count = this->GetTotalItemCount();
                 auto item_count = this->items_to_show;
-                if(item_count > this->items.size()) {
-                    item_count = this->items.size();
+                if(item_count > total_item_count) {
+                    item_count = total_item_count;
                 }
-                if((item_count + this->advanced_item_count) > this->items.size()) {
-                    item_count = this->items.size() - this->advanced_item_count;
+                if((item_count + this->advanced_item_count) > total_item_count) {
+                    item_count = total_item_count - this->advanced_item_count;
                 }
                 return item_count;
             }
 
+
         public:
             Menu(const i32 x, const i32 y, const i32 width, const Color items_clr, const Color items_focus_clr, const i32 items_height, const u32 items_to_show);
             PU_SMART_CTOR(Menu)
@@ -247,29 +359,60 @@ namespace pu::ui::elm {
             PU_CLASS_POD_GETSET(ShadowHeight, shadow_height, u32)
             PU_CLASS_POD_GETSET(ShadowBaseAlpha, shadow_base_alpha, u8)
             PU_CLASS_POD_GETSET(MoveWaitTimeMs, move_wait_time_ms, s64)
+            // Rows loaded beyond each end of the visible ones, whose text is also rendered ahead in the scrolling direction
+            PU_CLASS_POD_GETSET(PrefetchItemCount, prefetch_item_count, u32)
 
             inline void SetOnSelectionChanged(OnSelectionChangedCallback on_selection_changed_cb) {
                 this->on_selection_changed_cb = on_selection_changed_cb;
             }
 
+            // The item helpers below only act while rows come from the item list, and are ignored once a custom data source is set
+            // Use GetItemSource() to fill the item list meanwhile (like when a MenuFilter over it is set)
+
             inline void AddItem(MenuItem::Ref &item) {
-                this->items.push_back(item);
+                if(this->uses_item_src) {
+                    this->item_src->GetItems().push_back(item);
+                    this->InvalidateLoadedRows();
+                }
+            }
+
+            // Thread-safe, see MenuItemDataSource::PushItemBatch
+            inline void PushItemBatch(std::vector<MenuItem::Ref> items) {
+                if(this->uses_item_src) {
+                    this->item_src->PushItemBatch(std::move(items));
+                }
             }
 
             void ClearItems();
 
-            inline void ForceReloadItems() {
-                this->ReloadItemRenders();
-            }
+            // Needed after items change (or the data source's contents do), so that visible rows are requested again
+            void ForceReloadItems();
 
             PU_CLASS_POD_SET(CooldownEnabled, cooldown_enabled, bool)
 
-            inline MenuItem::Ref &GetSelectedItem() {
-                return this->items.at(this->selected_item_idx);
+            // Null with a custom data source set (its selected index isn't an item list index) or without items
+            inline MenuItem::Ref GetSelectedItem() {
+                if(!this->uses_item_src || (this->selected_item_idx >= this->item_src->GetItems().size())) {
+                    return nullptr;
+                }
+                return this->item_src->GetItems().at(this->selected_item_idx);
             }
 
+            // The item list itself, which isn't what the menu shows while a custom data source is set
             inline std::vector<MenuItem::Ref> &GetItems() {
-                return this->items;
+                return this->item_src->GetItems();
+            }
+
+            // The menu's own item list, kept (and not shown) while a custom data source is set, so it can still be the base of one
+            inline std::shared_ptr<MenuItemDataSource> GetItemSource() {
+                return this->item_src;
+            }
+
+            // Rows are pulled from the given source instead of the item list, or from the item list again if null
+            void SetDataSource(std::shared_ptr<MenuDataSource> data_src);
+
+            inline std::shared_ptr<MenuDataSource> GetDataSource() {
+                return this->data_src;
             }
 
             PU_CLASS_POD_GET(SelectedIndex, selected_item_idx, i32)
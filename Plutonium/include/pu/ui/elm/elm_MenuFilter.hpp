@@ -0,0 +1,140 @@
+
+/*
+
+    Plutonium library
+
+    @file MenuFilter.hpp
+    @brief A MenuFilter is a Menu data source showing a filtered and/or sorted view of another one.
+    @author XorTroll
+
+    @copyright Plutonium project - an easy-to-use UI framework for Nintendo Switch homebrew
+
+*/
+
+#pragma once
+#include <pu/ui/elm/elm_Menu.hpp>
+#include <pu/jobs/jobs_JobSystem.hpp>
+#include <unordered_map>
+
+namespace pu::ui::elm {
+
+    // Indexing, filtering and sorting happen as jobs, and the menu using the filter swaps to the new
+    // results all at once when they're ready, keeping the selected item selected if it's still there
+    class MenuFilter : public MenuDataSource {
+        public:
+            // Reads the sort value of the base source's item at the given index, only ever called on the menu's thread
+            using SortValueFunction = std::function<s64(const u32)>;
+
+            // Values are read for every item whenever items are indexed, so that jobs only sort those copies
+            struct SortKey {
+                // Empty for keys comparing the item names (case-insensitively)
+                SortValueFunction get_value;
+                bool descending;
+            };
+
+            // Queries at least this long are looked up in the index, shorter ones just check every item
+            static constexpr size_t NgramLength = 3;
+
+        private:
+            std::shared_ptr<MenuDataSource> base_src;
+            jobs::CancellationToken job_token;
+            jobs::JobHandle job;
+
+            // Guards everything shared with the job, below
+            Mutex lock;
+            // Only one job runs at a time, processing requests until there are no more
+            bool job_scheduled;
+            bool has_request;
+            std::vector<std::string> req_names;
+            // Values of every sort key for each item, one item after another
+            std::vector<s64> req_sort_values;
+            // Whether the items above replace the indexed ones, otherwise they're appended to them
+            bool req_names_set;
+            std::string req_query;
+            std::vector<SortKey> req_sort_keys;
+            bool has_result;
+            std::vector<u32> result_view;
+
+            // Only touched by the job
+            std::vector<std::string> folded_names;
+            std::vector<s64> sort_values;
+            std::unordered_map<u32, std::vector<u32>> ngram_index;
+            std::string last_query;
+            std::vector<u32> last_matches;
+            bool last_matches_valid;
+
+            // Only touched by the menu's thread
+            std::vector<u32> view;
+            bool view_changed;
+            std::vector<SortKey> sort_keys;
+            // Base items copied (and sent to be indexed) so far
+            u32 indexed_count;
+
+            void ProcessRequests(const jobs::CancellationToken &token);
+            void ProcessRequest(std::vector<std::string> &names, std::vector<s64> &sort_values, const bool names_set, const std::string &query, const std::vector<SortKey> &sort_keys, const jobs::CancellationToken &token);
+            void ClearIndex();
+            // Both stop early (leaving their results unusable) once the token is cancelled
+            bool IndexItems(std::vector<std::string> &names, std::vector<s64> &sort_values, const jobs::CancellationToken &token);
+            bool FindMatches(const std::string &folded_query, const jobs::CancellationToken &token, std::vector<u32> &out_matches);
+            void CopyItems(const u32 start_idx, const u32 end_idx, std::vector<std::string> &out_names, std::vector<s64> &out_sort_values);
+            void AppendItems(const u32 item_count);
+            bool PostRequest();
+            void SubmitJob();
+
+        public:
+            MenuFilter(std::shared_ptr<MenuDataSource> base_src);
+            PU_SMART_CTOR(MenuFilter)
+            ~MenuFilter();
+
+            // Copies the base source's item names and sort values (on the calling thread) and indexes them again in the background
+            // Needed after the base source's contents change, except for items appended to it while polled (like MenuItemDataSource's
+            // pushed batches), which are indexed on their own and shown right away if nothing is filtered or sorted
+            void Reindex();
+
+            // Items whose names contain the query (case-insensitively), or every item if empty
+            void SetQuery(const std::string &query);
+            // Applied in order, the original order is kept among items comparing equal by every key
+            // Reindexes right away, since the new keys' values need to be read from every item
+            void SetSortKeys(const std::vector<SortKey> &sort_keys);
+
+            static inline SortKey MakeNameSortKey(const bool descending = false) {
+                return { {}, descending };
+            }
+
+            // Smaller values go first (unless descending)
+            static inline SortKey MakeValueSortKey(SortValueFunction get_value, const bool descending = false) {
+                return { get_value, descending };
+            }
+
+            inline std::shared_ptr<MenuDataSource> GetBaseDataSource() {
+                return this->base_src;
+            }
+
+            inline u32 GetBaseIndex(const u32 idx) {
+                return this->view.at(idx);
+            }
+
+            u32 GetItemCount() override {
+                return this->view.size();
+            }
+
+            std::string GetItemName(const u32 idx) override {
+                return this->base_src->GetItemName(this->view.at(idx));
+            }
+
+            Color GetItemColor(const u32 idx) override {
+                return this->base_src->GetItemColor(this->view.at(idx));
+            }
+
+            sdl2::TextureHandle::Ref GetItemIcon(const u32 idx) override {
+                return this->base_src->GetItemIcon(this->view.at(idx));
+            }
+
+            void OnItemKey(const u32 idx, const u64 keys) override {
+                this->base_src->OnItemKey(this->view.at(idx), keys);
+            }
+
+            bool PollChanges(u32 &selected_idx) override;
+    };
+
+}
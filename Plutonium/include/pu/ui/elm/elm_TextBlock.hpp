@@ -25,8 +25,16 @@ namespace pu::ui::elm {
             i32 y;
             Color clr;
             std::string text;
-            sdl2::Texture text_tex;
+            render::TextTexture text_tex;
             std::string fnt_name;
+            u32 wrap_width;
+            // Measured when the text is requested, so it's known right away even if rasterized asynchronously
+            i32 text_w;
+            i32 text_h;
+            // Text properties may be set from background threads
+            RMutex lock;
+
+            void RequestText();
         
         public:
             TextBlock(const i32 x, const i32 y, const std::string &text);
@@ -52,13 +60,16 @@ namespace pu::ui::elm {
             i32 GetWidth() override;
             i32 GetHeight() override;
 
-            inline std::string GetText() {
-                return this->text;
-            }
+            std::string GetText();
 
+            // Setters can be called from any thread, the previous text keeps being shown until the new one is ready
             void SetText(const std::string &text);
             void SetFont(const std::string &font_name);
 
+            PU_CLASS_POD_GET(WrapWidth, wrap_width, u32)
+
+            void SetWrapWidth(const u32 wrap_width);
+
             PU_CLASS_POD_GET(Color, clr, Color)
             
             void SetColor(const Color clr);
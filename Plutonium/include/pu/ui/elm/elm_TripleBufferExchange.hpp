@@ -0,0 +1,68 @@
+/*
+
+    Plutonium library
+
+    @file TripleBufferExchange.hpp
+    @brief A TripleBufferExchange hands buffers from a producer thread to a consumer one without either waiting. (used by VideoFrameSink)
+    @author XorTroll
+
+    @copyright Plutonium project - an easy-to-use UI framework for Nintendo Switch homebrew
+
+*/
+
+#pragma once
+#include <pu/pu_Include.hpp>
+#include <atomic>
+
+namespace pu::ui::elm {
+
+    // Only tracks buffer indices, so that the exchange can be tested apart from the buffers themselves
+    // The producer fills the write buffer and publishes it, the consumer acquires the latest published one as its read buffer
+    class TripleBufferExchange {
+        public:
+            static constexpr u32 BufferCount = 3;
+
+        private:
+            // The ready buffer's index, and whether it was published but not acquired yet
+            static constexpr u8 FreshBufferBit = BIT(2);
+            static constexpr u8 BufferIndexMask = 0b11;
+
+            // Only touched by the producer
+            u8 write_buf_idx;
+            // Exchanged between the producer and the consumer
+            std::atomic<u8> ready_buf_state;
+            // Only touched by the consumer
+            u8 read_buf_idx;
+
+        public:
+            TripleBufferExchange() : write_buf_idx(0), ready_buf_state(1), read_buf_idx(2) {}
+
+            inline u32 GetWriteIndex() const {
+                return this->write_buf_idx;
+            }
+
+            inline u32 GetReadIndex() const {
+                return this->read_buf_idx;
+            }
+
+            // The written buffer becomes the ready one, and the previous ready one is written next
+            // Returns whether that one was replaced before being acquired (thus dropped)
+            inline bool Publish() {
+                const auto prev_state = this->ready_buf_state.exchange(this->write_buf_idx | FreshBufferBit, std::memory_order_acq_rel);
+                this->write_buf_idx = prev_state & BufferIndexMask;
+                return prev_state & FreshBufferBit;
+            }
+
+            // Returns whether a newly published buffer was acquired, otherwise the read buffer is still the last acquired one
+            inline bool Acquire() {
+                if(!(this->ready_buf_state.load(std::memory_order_relaxed) & FreshBufferBit)) {
+                    return false;
+                }
+
+                const auto prev_state = this->ready_buf_state.exchange(this->read_buf_idx, std::memory_order_acq_rel);
+                this->read_buf_idx = prev_state & BufferIndexMask;
+                return true;
+            }
+    };
+
+}
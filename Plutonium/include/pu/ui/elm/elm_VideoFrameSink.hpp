@@ -0,0 +1,139 @@
+
+/*
+
+    Plutonium library
+
+    @file VideoFrameSink.hpp
+    @brief A VideoFrameSink is an Element showing video frames produced elsewhere. (RGBA, I420, NV12)
+    @author XorTroll
+
+    @copyright Plutonium project - an easy-to-use UI framework for Nintendo Switch homebrew
+
+*/
+
+#pragma once
+#include <pu/ui/elm/elm_Element.hpp>
+#include <pu/ui/elm/elm_TripleBufferExchange.hpp>
+#include <chrono>
+#include <array>
+#include <atomic>
+
+namespace pu::ui::elm {
+
+    enum class VideoFrameFormat : u8 {
+        RGBA,
+        // Three planes: Y, then U and V at half width and height
+        I420,
+        // Two planes: Y, then interleaved UV at half width and height
+        NV12
+    };
+
+    struct VideoFrame {
+        // Only the planes used by the sink's format are read, with any pitch
+        std::array<const u8*, 3> planes;
+        std::array<i32, 3> pitches;
+    };
+
+    struct VideoFrameStatistics {
+        u64 pushed_count;
+        u64 shown_count;
+        // Replaced by a newer frame before they could be shown
+        u64 dropped_count;
+        // Shown later than the late threshold after being pushed
+        u64 late_count;
+    };
+
+    // Frames are pushed into a triple buffer, so neither the producer nor the renderer ever waits for the other
+    // Buffers are allocated upfront and the texture on the first render, so streaming frames never allocates
+    class VideoFrameSink : public Element {
+        public:
+            static constexpr s64 DefaultLateThresholdUs = 33333;
+
+        private:
+            struct FrameBuffer {
+                std::vector<u8> data;
+                std::chrono::time_point<std::chrono::steady_clock> push_time;
+            };
+
+            i32 x;
+            i32 y;
+            render::TextureRenderOptions rend_opts;
+            u32 frame_width;
+            u32 frame_height;
+            VideoFrameFormat fmt;
+            std::array<FrameBuffer, TripleBufferExchange::BufferCount> frame_bufs;
+            // Serializes producers, since the exchange only supports one at a time
+            Mutex producer_lock;
+            TripleBufferExchange buf_exchange;
+            sdl2::Texture tex;
+            bool has_frame;
+            s64 late_threshold_us;
+            std::atomic<u64> pushed_count;
+            std::atomic<u64> shown_count;
+            std::atomic<u64> dropped_count;
+            std::atomic<u64> late_count;
+
+            inline u32 GetChromaWidth() {
+                return (this->frame_width + 1) / 2;
+            }
+
+            inline u32 GetChromaHeight() {
+                return (this->frame_height + 1) / 2;
+            }
+
+            void CopyPlane(u8 *dst, const u8 *src, const i32 src_pitch, const u32 row_size, const u32 row_count);
+            void UploadFrame(const FrameBuffer &frame_buf);
+
+        public:
+            VideoFrameSink(const i32 x, const i32 y, const u32 frame_width, const u32 frame_height, const VideoFrameFormat fmt);
+            PU_SMART_CTOR(VideoFrameSink)
+            ~VideoFrameSink();
+
+            inline i32 GetX() override {
+                return this->x;
+            }
+
+            inline void SetX(const i32 x) {
+                this->x = x;
+            }
+
+            inline i32 GetY() override {
+                return this->y;
+            }
+
+            inline void SetY(const i32 y) {
+                this->y = y;
+            }
+
+            inline i32 GetWidth() override {
+                return this->rend_opts.width;
+            }
+
+            inline void SetWidth(const i32 width) {
+                this->rend_opts.width = width;
+            }
+
+            inline i32 GetHeight() override {
+                return this->rend_opts.height;
+            }
+
+            inline void SetHeight(const i32 height) {
+                this->rend_opts.height = height;
+            }
+
+            PU_CLASS_POD_GET(FrameWidth, frame_width, u32)
+            PU_CLASS_POD_GET(FrameHeight, frame_height, u32)
+            PU_CLASS_POD_GET(Format, fmt, VideoFrameFormat)
+            PU_CLASS_POD_GETSET(LateThresholdUs, late_threshold_us, s64)
+
+            // Safe to call from any thread, copying the frame so that its planes may be reused right away
+            void PushFrame(const VideoFrame &frame);
+
+            VideoFrameStatistics GetStatistics();
+            void ResetStatistics();
+
+            void OnRender(render::Renderer::Ref &drawer, const i32 x, const i32 y) override;
+            void OnInput(const u64 keys_down, const u64 keys_up, const u64 keys_held, const TouchPoint touch_pos) override {}
+    };
+
+}
@@ -11,10 +11,15 @@
 */
 
 #pragma once
+#include <pu/jobs/jobs_JobSystem.hpp>
 #include <pu/ttf/ttf_Font.hpp>
+#include <pu/ttf/ttf_GlyphCache.hpp>
 #include <pu/ui/render/render_SDL2.hpp>
+#include <pu/ui/render/render_TextTexture.hpp>
+#include <pu/ui/render/render_TextureTracker.hpp>
 #include <pu/ui/ui_Types.hpp>
 #include <vector>
+#include <functional>
 
 namespace pu::ui::render {
 
@@ -26,6 +31,12 @@ constexpr u32 ScreenHeight = 1080;
 
 constexpr double ScreenFactor = (double)ScreenWidth / (double)BaseScreenWidth;
 
+constexpr u32 DefaultAudioSampleRate = 44100;
+constexpr u32 DefaultAudioBufferSampleCount = 4096;
+// The console outputs at 48kHz, so this also avoids resampling, while the buffer adds around 10ms
+constexpr u32 LowLatencyAudioSampleRate = 48000;
+constexpr u32 LowLatencyAudioBufferSampleCount = 512;
+
 struct RendererInitOptions {
     u32 sdl_flags;
     u32 sdl_render_flags;
@@ -34,8 +45,18 @@ struct RendererInitOptions {
     std::vector<PlSharedFontType> default_shared_fonts;
     std::vector<std::string> default_font_paths;
     std::vector<u32> extra_default_font_sizes;
+    u32 max_loaded_font_sizes;
+    std::string glyph_cache_path;
+    std::string glyph_cache_prewarm_charset;
+    u32 text_render_worker_count;
+    u32 job_worker_count;
+    bool premultiply_alpha;
     bool init_mixer;
     u32 audio_mixer_flags;
+    u32 audio_sample_rate;
+    u32 audio_buffer_sample_count;
+    u32 audio_channel_count;
+    bool audio_latency_measurement;
     bool init_img;
     u32 sdl_img_flags;
     bool init_romfs;
@@ -56,8 +77,18 @@ struct RendererInitOptions {
         default_shared_fonts(),
         default_font_paths(),
         extra_default_font_sizes(),
+        max_loaded_font_sizes(0),
+        glyph_cache_path(),
+        glyph_cache_prewarm_charset(),
+        text_render_worker_count(0),
+        job_worker_count(0),
+        premultiply_alpha(false),
         init_mixer(false),
         audio_mixer_flags(0),
+        audio_sample_rate(DefaultAudioSampleRate),
+        audio_buffer_sample_count(DefaultAudioBufferSampleCount),
+        audio_channel_count(MIX_DEFAULT_CHANNELS),
+        audio_latency_measurement(false),
         init_img(false),
         sdl_img_flags(0),
         init_romfs(false),
@@ -75,13 +106,49 @@ struct RendererInitOptions {
 
     inline void AddDefaultFontPath(const std::string& font_path) { this->default_font_paths.push_back(font_path); }
 
+    // Default font sizes are loaded on first use anyway, extra ones are just loaded upfront
     inline void AddExtraDefaultFontSize(const u32 font_size) { this->extra_default_font_sizes.push_back(font_size); }
 
+    // Fonts loaded from families are closed (least recently used first) past this count, zero means no limit
+    inline void SetMaxLoadedFontSizes(const u32 count) { this->max_loaded_font_sizes = count; }
+
+    // Keeps rendered glyphs in the given file (ideally in the app's save directory) across launches
+    // With a charset, only its glyphs are kept, and they're rendered in the background right after initializing
+    // for the default font sizes loaded upfront (see AddExtraDefaultFontSize)
+    inline void UseGlyphCache(const std::string& cache_path, const std::string& prewarm_charset = "") {
+        this->glyph_cache_path = cache_path;
+        this->glyph_cache_prewarm_charset = prewarm_charset;
+    }
+
+    // Text of elements is rasterized as jobs, only uploading the result on the render thread
+    // The job system gets at least this many workers
+    inline void UseAsyncTextRendering(const u32 worker_count = DefaultTextRenderWorkerCount) {
+        this->text_render_worker_count = worker_count;
+    }
+
+    // Starts the job system, which also runs the library's own background work (text, glyph cache prewarming, menu filters...)
+    inline void UseJobs(const u32 worker_count = jobs::DefaultWorkerCount) { this->job_worker_count = worker_count; }
+
+    // Textures created by the library get premultiplied alpha (and the matching blend mode), avoiding fringes when scaled
+    inline void UsePremultipliedAlpha() { this->premultiply_alpha = true; }
+
     inline void UseAudio(const u32 audio_mixer_flags) {
         this->init_mixer = true;
         this->audio_mixer_flags = audio_mixer_flags;
     }
 
+    // Smaller buffers make sounds heard sooner, at the risk of underruns (audible crackling) if mixing falls behind
+    inline void SetAudioFormat(const u32 sample_rate, const u32 buffer_sample_count, const u32 channel_count = MIX_DEFAULT_CHANNELS) {
+        this->audio_sample_rate = sample_rate;
+        this->audio_buffer_sample_count = buffer_sample_count;
+        this->audio_channel_count = channel_count;
+    }
+
+    inline void UseLowLatencyAudio() { this->SetAudioFormat(LowLatencyAudioSampleRate, LowLatencyAudioBufferSampleCount); }
+
+    // Measures how long played sounds take to be mixed, see audio::GetLatencyStatistics
+    inline void UseAudioLatencyMeasurement() { this->audio_latency_measurement = true; }
+
     inline void UseImage(const u32 sdl_img_flags) {
         this->init_img = true;
         this->sdl_img_flags = sdl_img_flags;
@@ -175,6 +242,22 @@ public:
         const i32 y,
         const TextureRenderOptions opts = TextureRenderOptions::Default()
     );
+    // Uses the handle's known dimensions, and its closest mipmap level (if any) when drawn at a smaller size
+    void RenderTexture(
+        sdl2::TextureHandle::Ref tex_handle,
+        const i32 x,
+        const i32 y,
+        const TextureRenderOptions opts = TextureRenderOptions::Default()
+    );
+    // Draws part of a texture, like a tile of an atlas: SDL batches consecutive draws from the same texture
+    void RenderTextureRegion(
+        sdl2::Texture texture,
+        const SDL_Rect& src_rect,
+        const i32 x,
+        const i32 y,
+        const i32 width,
+        const i32 height
+    );
     void RenderRectangle(const Color clr, const i32 x, const i32 y, const i32 width, const i32 height);
     void RenderRectangleFill(const Color clr, const i32 x, const i32 y, const i32 width, const i32 height);
 
@@ -235,6 +318,10 @@ public:
 
     inline void ResetBaseRenderAlpha() { this->base_a = -1; }
 
+    // Restricts rendering to the given area (relative to the base position) until reset
+    void SetClipRectangle(const i32 x, const i32 y, const i32 width, const i32 height);
+    void ResetClipRectangle();
+
     inline void UpdateInput() { padUpdate(&this->input_pad); }
 
     inline u64 GetButtonsDown() { return padGetButtonsDown(&this->input_pad); }
@@ -251,11 +338,19 @@ sdl2::Window GetMainWindow();
 sdl2::Surface GetMainSurface();
 
 std::pair<u32, u32> GetDimensions();
+// Width text wraps at when no wrap width is given (the window's width), safe to get from any thread
+u32 GetDefaultWrapWidth();
 
 // Font loading
 
 bool AddFont(const std::string& font_name, std::shared_ptr<ttf::Font>& font);
 
+// Loads the faces of a family into a newly created font of the requested size
+using FontFamilyLoadFunction = std::function<bool(std::shared_ptr<ttf::Font>&)>;
+
+bool AddFontFamily(const std::string& font_family, FontFamilyLoadFunction load_fn);
+std::shared_ptr<ttf::Font> FindFont(const std::string& font_name);
+
 bool LoadSingleSharedFontInFont(std::shared_ptr<ttf::Font>& font, const PlSharedFontType type);
 bool LoadAllSharedFontsInFont(std::shared_ptr<ttf::Font>& font);
 
@@ -266,14 +361,32 @@ inline void AddDefaultFont(std::shared_ptr<ttf::Font>& font) {
 // Text rendering
 
 bool GetTextDimensions(const std::string& font_name, const std::string& text, i32& out_width, i32& out_height);
+// Size of the text as rendered below with the same wrap width (the window's width if zero), without rasterizing it
+bool GetWrappedTextDimensions(
+    const std::string& font_name,
+    const std::string& text,
+    const u32 wrap_width,
+    i32& out_width,
+    i32& out_height
+);
 i32 GetTextWidth(const std::string& font_name, const std::string& text);
 i32 GetTextHeight(const std::string& font_name, const std::string& text);
+// Same as below, but can be called from any thread since no texture is created
+sdl2::Surface RenderTextSurface(
+    const std::string& font_name,
+    const std::string& text,
+    const Color clr,
+    const u32 max_width = 0,
+    const u32 max_height = 0,
+    const u32 wrap_width = 0
+);
 sdl2::Texture RenderText(
     const std::string& font_name,
     const std::string& text,
     const Color clr,
     const u32 max_width = 0,
-    const u32 max_height = 0
+    const u32 max_height = 0,
+    const u32 wrap_width = 0
 );
 
 }  // namespace pu::ui::render
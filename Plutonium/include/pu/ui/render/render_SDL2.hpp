@@ -17,8 +17,28 @@
 
 namespace pu::ui::render {
 
+    // Textures are created from RGBA32 surfaces, which the renderer takes as they are
+    // Alpha may also be premultiplied, which avoids dark fringes when textures are scaled or blended
+    void SetPremultipliedAlphaEnabled(const bool enabled);
+    bool IsPremultipliedAlphaEnabled();
+    SDL_BlendMode GetNormalizedBlendMode();
+
+    // Converts the surface into RGBA32 (with alpha premultiplied if enabled), freeing it
+    // It may be called from any thread, ideally wherever the surface is decoded
+    sdl2::Surface NormalizeSurface(sdl2::Surface surface);
+    // For surfaces already normalized, so that no conversion is left for the render thread
+    sdl2::Texture ConvertNormalizedToTexture(sdl2::Surface surface);
+
     sdl2::Texture ConvertToTexture(sdl2::Surface surface);
     sdl2::Texture LoadImage(const std::string &path);
+
+    // Also generate successively halved copies of the image, which are picked when drawing it at smaller sizes
+    sdl2::TextureHandle::Ref ConvertToTextureWithMipmaps(sdl2::Surface surface);
+    sdl2::TextureHandle::Ref LoadImageWithMipmaps(const std::string &path);
+
+    // Box-filtered halvings followed by a final stretch, returning a new RGBA surface (the given one is kept)
+    sdl2::Surface ResizeSurface(sdl2::Surface surface, const i32 width, const i32 height);
+
     i32 GetTextureWidth(sdl2::Texture texture);
     i32 GetTextureHeight(sdl2::Texture texture);
     void SetAlphaValue(sdl2::Texture texture, const u8 alpha);
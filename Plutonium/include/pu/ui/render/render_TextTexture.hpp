@@ -0,0 +1,52 @@
+
+/*
+
+    Plutonium library
+
+    @file render_TextTexture.hpp
+    @brief Text textures whose rasterization may happen on worker threads
+    @author XorTroll
+
+    @copyright Plutonium project - an easy-to-use UI framework for Nintendo Switch homebrew
+
+*/
+
+#pragma once
+#include <pu/ui/ui_Types.hpp>
+#include <pu/sdl2/sdl2_Types.hpp>
+
+namespace pu::ui::render {
+
+    constexpr u32 DefaultTextRenderWorkerCount = 2;
+
+    // Requested text is rasterized into surfaces as jobs, textures are still only created on the render thread
+    // Initializing starts the job system with this many workers, unless it's running already
+    bool InitializeTextRenderWorkers(const u32 worker_count);
+    void FinalizeTextRenderWorkers();
+    bool IsAsyncTextRenderingEnabled();
+
+    class TextTexture {
+        public:
+            // Shared with the workers, so that a texture can be destroyed while its text is still being rasterized
+            struct State;
+
+        private:
+            std::shared_ptr<State> state;
+            sdl2::Texture tex;
+
+        public:
+            TextTexture();
+            TextTexture(const TextTexture&) = delete;
+            TextTexture &operator=(const TextTexture&) = delete;
+            ~TextTexture();
+
+            // Can be called from any thread: text is rasterized right away unless async text rendering is enabled
+            // Either way, the texture is only replaced the next time it's obtained, superseded requests are dropped
+            void Request(const std::string &font_name, const std::string &text, const Color clr, const u32 max_width = 0, const u32 max_height = 0, const u32 wrap_width = 0);
+
+            // Render thread only: uploads the latest finished text (if any) and returns the current texture
+            sdl2::Texture Get();
+            void Clear();
+    };
+
+}
@@ -0,0 +1,81 @@
+
+/*
+
+    Plutonium library
+
+    @file render_TextureTracker.hpp
+    @brief Accounting of the textures created by the library, for memory budgeting and leak finding
+    @author XorTroll
+
+    @copyright Plutonium project - an easy-to-use UI framework for Nintendo Switch homebrew
+
+*/
+
+#pragma once
+#include <pu/ui/ui_Types.hpp>
+#include <pu/sdl2/sdl2_Types.hpp>
+#include <vector>
+#include <functional>
+
+namespace pu::ui::render {
+
+    struct TrackedTextureInfo {
+        sdl2::Texture tex;
+        std::string tag;
+        // The element or layout being rendered when the texture was created, if any
+        const void *owner;
+        size_t byte_size;
+    };
+
+    struct TextureTagUsage {
+        std::string tag;
+        u32 tex_count;
+        size_t byte_size;
+    };
+
+    // Called with the live bytes whenever a texture is created while they're over the budget, so that caches can be trimmed
+    // It's called without any lock held, so it may delete textures
+    using TextureBudgetCallback = std::function<void(const size_t live_bytes, const size_t budget_bytes)>;
+    using TextureLeakReportCallback = std::function<void(const std::vector<TrackedTextureInfo>&)>;
+
+    // Every texture created by the library is tracked here, and untracked by DeleteTexture
+    // Tags must be string literals (or otherwise outlive the texture), the scope's tag (if any) takes precedence over the given one
+    void TrackTexture(sdl2::Texture tex, const char *tag);
+    void UntrackTexture(sdl2::Texture tex);
+    void SetTextureOwner(sdl2::Texture tex, const void *owner);
+
+    size_t GetLiveTextureBytes();
+    u32 GetLiveTextureCount();
+    std::vector<TextureTagUsage> GetTextureUsageByTag();
+    std::vector<TrackedTextureInfo> GetTrackedTextures();
+
+    // Zero means no budget
+    void SetTextureBudget(const size_t budget_bytes, TextureBudgetCallback budget_cb);
+    // Called by the renderer on finalization with every texture still alive, which are then no longer tracked
+    void SetTextureLeakReportCallback(TextureLeakReportCallback leak_report_cb);
+    void ReportTextureLeaks();
+
+    // While alive, textures created on the same thread are tagged/owned by the given tag/owner, restoring the previous ones afterwards
+    class TextureTagScope {
+        private:
+            const char *prev_tag;
+
+        public:
+            TextureTagScope(const char *tag);
+            TextureTagScope(const TextureTagScope&) = delete;
+            TextureTagScope &operator=(const TextureTagScope&) = delete;
+            ~TextureTagScope();
+    };
+
+    class TextureOwnerScope {
+        private:
+            const void *prev_owner;
+
+        public:
+            TextureOwnerScope(const void *owner);
+            TextureOwnerScope(const TextureOwnerScope&) = delete;
+            TextureOwnerScope &operator=(const TextureOwnerScope&) = delete;
+            ~TextureOwnerScope();
+    };
+
+}
@@ -46,6 +46,10 @@ namespace pu::ui {
             OnInputCallback on_ipt_cb;
             render::Renderer::Ref renderer;
             RMutex render_lock;
+            // Frames being rendered (nested while dialogs are shown), closing only finishes once none is
+            u32 render_depth;
+            bool close_pending;
+            bool close_pending_exit;
         
         public:
             Application(render::Renderer::Ref renderer);
@@ -140,6 +144,8 @@ namespace pu::ui {
             void SetFadeBackgroundColor(const Color clr);
             
             void OnRender();
+            // The layout and overlay are released before finalizing the renderer
+            // When called while rendering (like from a callback), finalizing (and exiting) happens once the frame ends
             void Close(const bool do_exit = false);
             
             inline void CloseWithFadeOut(const bool do_exit = false) {
@@ -29,8 +29,16 @@ namespace pu::ui {
     
     constexpr u32 DefaultFontSizes[static_cast<u32>(DefaultFontSize::Count)] = { 27, 30, 37, 45 };
 
+    // Fonts of a family are named "<family>@<size>", and any size of a registered family can be used
+
+    constexpr const char *DefaultFontFamily = "DefaultFont";
+
+    inline std::string MakeFontName(const std::string &font_family, const u32 font_size) {
+        return font_family + "@" + std::to_string(font_size);
+    }
+
     inline std::string MakeDefaultFontName(const u32 font_size) {
-        return "DefaultFont@" + std::to_string(font_size);
+        return MakeFontName(DefaultFontFamily, font_size);
     }
 
     inline constexpr u32 GetDefaultFontSize(const DefaultFontSize kind) {
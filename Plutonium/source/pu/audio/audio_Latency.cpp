@@ -0,0 +1,136 @@
+#include <pu/audio/audio_Latency.hpp>
+#include <atomic>
+#include <chrono>
+
+namespace pu::audio {
+
+    namespace {
+
+        using Clock = std::chrono::steady_clock;
+
+        constexpr u32 MaxPendingPlayCount = 64;
+
+        std::atomic_bool g_MeasurementEnabled = false;
+        i32 g_OutputFrequency = 0;
+        u32 g_OutputFrameSize = 0;
+
+        // Play times are queued (single producer, guarded among players by their own lock) for the post-mix callback to consume
+        // SDL_mixer's device can't be locked from outside, so the callback never takes any lock
+        Mutex g_PlayLock = {};
+        Clock::rep g_PendingPlayTimes[MaxPendingPlayCount];
+        std::atomic<u32> g_PendingWritePos = 0;
+        std::atomic<u32> g_PendingReadPos = 0;
+
+        std::atomic<u64> g_MeasuredCount = 0;
+        std::atomic<u64> g_MinLatencyUs = UINT64_MAX;
+        std::atomic<u64> g_MaxLatencyUs = 0;
+        std::atomic<u64> g_TotalLatencyUs = 0;
+        std::atomic<u64> g_BufferUs = 0;
+
+        void RecordLatency(const u64 latency_us) {
+            auto min_latency_us = g_MinLatencyUs.load();
+            while((latency_us < min_latency_us) && !g_MinLatencyUs.compare_exchange_weak(min_latency_us, latency_us));
+            auto max_latency_us = g_MaxLatencyUs.load();
+            while((latency_us > max_latency_us) && !g_MaxLatencyUs.compare_exchange_weak(max_latency_us, latency_us));
+            g_TotalLatencyUs += latency_us;
+            g_MeasuredCount++;
+        }
+
+        void PostMixCallback(void*, u8*, i32 stream_len) {
+            // The buffer actually obtained from the device, which may differ from the requested one
+            if((g_OutputFrequency > 0) && (g_OutputFrameSize > 0)) {
+                g_BufferUs.store(((static_cast<u64>(stream_len) / g_OutputFrameSize) * 1'000'000) / g_OutputFrequency, std::memory_order_relaxed);
+            }
+
+            const auto write_pos = g_PendingWritePos.load(std::memory_order_acquire);
+            auto read_pos = g_PendingReadPos.load(std::memory_order_relaxed);
+            if(read_pos == write_pos) {
+                return;
+            }
+
+            // Sounds played before this callback started are mixed within it
+            const auto now = Clock::now().time_since_epoch().count();
+            for(; read_pos != write_pos; read_pos++) {
+                const auto play_time = g_PendingPlayTimes[read_pos % MaxPendingPlayCount];
+                RecordLatency(std::chrono::duration_cast<std::chrono::microseconds>(Clock::duration(now - play_time)).count());
+            }
+            g_PendingReadPos.store(read_pos, std::memory_order_release);
+        }
+
+    }
+
+    void EnableLatencyMeasurement() {
+        DisableLatencyMeasurement();
+
+        i32 freq = 0;
+        u16 fmt = 0;
+        i32 channel_count = 0;
+        if(!Mix_QuerySpec(&freq, &fmt, &channel_count) || (freq <= 0) || (channel_count <= 0)) {
+            return;
+        }
+
+        // Nothing else touches these until the callback is set
+        g_OutputFrequency = freq;
+        g_OutputFrameSize = (SDL_AUDIO_BITSIZE(fmt) / 8) * channel_count;
+        g_PendingWritePos = 0;
+        g_PendingReadPos = 0;
+        g_BufferUs = 0;
+        ResetLatencyStatistics();
+
+        Mix_SetPostMix(PostMixCallback, nullptr);
+        g_MeasurementEnabled = true;
+    }
+
+    void DisableLatencyMeasurement() {
+        if(!g_MeasurementEnabled) {
+            return;
+        }
+
+        // Once this returns the callback is no longer running
+        g_MeasurementEnabled = false;
+        Mix_SetPostMix(nullptr, nullptr);
+    }
+
+    bool IsLatencyMeasurementEnabled() {
+        return g_MeasurementEnabled;
+    }
+
+    i32 PlayChunk(const i32 channel, Mix_Chunk *chunk) {
+        if(!g_MeasurementEnabled) {
+            return Mix_PlayChannel(channel, chunk, 0);
+        }
+
+        // Queued once playing, so a callback running right as the sound is played may make it count one buffer late, but never early
+        const auto play_time = Clock::now().time_since_epoch().count();
+        const auto played_channel = Mix_PlayChannel(channel, chunk, 0);
+        if(played_channel >= 0) {
+            mutexLock(&g_PlayLock);
+            const auto write_pos = g_PendingWritePos.load(std::memory_order_relaxed);
+            if((write_pos - g_PendingReadPos.load(std::memory_order_acquire)) < MaxPendingPlayCount) {
+                g_PendingPlayTimes[write_pos % MaxPendingPlayCount] = play_time;
+                g_PendingWritePos.store(write_pos + 1, std::memory_order_release);
+            }
+            mutexUnlock(&g_PlayLock);
+        }
+        return played_channel;
+    }
+
+    LatencyStatistics GetLatencyStatistics() {
+        const auto measured_count = g_MeasuredCount.load();
+        return {
+            .measured_count = measured_count,
+            .min_us = (measured_count > 0) ? g_MinLatencyUs.load() : 0,
+            .max_us = g_MaxLatencyUs,
+            .total_us = g_TotalLatencyUs,
+            .buffer_us = g_BufferUs
+        };
+    }
+
+    void ResetLatencyStatistics() {
+        g_MeasuredCount = 0;
+        g_MinLatencyUs = UINT64_MAX;
+        g_MaxLatencyUs = 0;
+        g_TotalLatencyUs = 0;
+    }
+
+}
@@ -0,0 +1,390 @@
+#include <pu/audio/audio_MusicPlayer.hpp>
+#include <tremor/ivorbisfile.h>
+#include <algorithm>
+#include <cstring>
+
+namespace pu::audio {
+
+    namespace {
+
+        constexpr u32 SourceBufferFrameCount = 2048;
+        constexpr u64 DecoderWaitTimeoutNs = 5'000'000;
+
+    }
+
+    struct MusicPlayer::Deck {
+        OggVorbis_File vf;
+        bool vf_open;
+        // Only used when preloaded
+        std::vector<u8> file_data;
+        size_t file_data_offset;
+        bool loop;
+        bool ended;
+        u32 src_channel_count;
+        double src_step;
+        // Decoded frames, the last one of the previous batch is kept first to interpolate across batches
+        std::vector<s16> src_buf;
+        u32 src_frame_count;
+        double src_pos;
+        float gain;
+        float gain_step;
+
+        Deck() : vf(), vf_open(false), file_data(), file_data_offset(0), loop(false), ended(false), src_channel_count(0), src_step(1.0), src_buf(), src_frame_count(0), src_pos(0.0), gain(1.0f), gain_step(0.0f) {}
+
+        ~Deck() {
+            if(this->vf_open) {
+                ov_clear(&this->vf);
+            }
+        }
+
+        static size_t MemoryRead(void *ptr, size_t size, size_t nmemb, void *deck_ptr) {
+            auto deck = reinterpret_cast<Deck*>(deck_ptr);
+            if(size == 0) {
+                return 0;
+            }
+            const auto read_nmemb = std::min(nmemb, (deck->file_data.size() - deck->file_data_offset) / size);
+            std::memcpy(ptr, deck->file_data.data() + deck->file_data_offset, read_nmemb * size);
+            deck->file_data_offset += read_nmemb * size;
+            return read_nmemb;
+        }
+
+        static int MemorySeek(void *deck_ptr, ogg_int64_t offset, int whence) {
+            auto deck = reinterpret_cast<Deck*>(deck_ptr);
+            s64 new_offset = offset;
+            if(whence == SEEK_CUR) {
+                new_offset += deck->file_data_offset;
+            }
+            else if(whence == SEEK_END) {
+                new_offset += deck->file_data.size();
+            }
+            if((new_offset < 0) || (static_cast<size_t>(new_offset) > deck->file_data.size())) {
+                return -1;
+            }
+            deck->file_data_offset = new_offset;
+            return 0;
+        }
+
+        static long MemoryTell(void *deck_ptr) {
+            return reinterpret_cast<Deck*>(deck_ptr)->file_data_offset;
+        }
+
+        bool Open(const std::string &path, const bool preload) {
+            if(preload) {
+                auto f = fopen(path.c_str(), "rb");
+                if(f == nullptr) {
+                    return false;
+                }
+                fseek(f, 0, SEEK_END);
+                const auto f_size = ftell(f);
+                rewind(f);
+                if(f_size > 0) {
+                    this->file_data.resize(f_size);
+                    if(fread(this->file_data.data(), 1, f_size, f) != static_cast<size_t>(f_size)) {
+                        this->file_data.clear();
+                    }
+                }
+                fclose(f);
+                if(this->file_data.empty()) {
+                    return false;
+                }
+
+                const ov_callbacks mem_callbacks = { MemoryRead, MemorySeek, nullptr, MemoryTell };
+                this->vf_open = ov_open_callbacks(this, &this->vf, nullptr, 0, mem_callbacks) == 0;
+            }
+            else {
+                auto f = fopen(path.c_str(), "rb");
+                if(f == nullptr) {
+                    return false;
+                }
+                // The file is closed along with the decoder, but only if it was opened successfully
+                this->vf_open = ov_open(f, &this->vf, nullptr, 0) == 0;
+                if(!this->vf_open) {
+                    fclose(f);
+                }
+            }
+            if(!this->vf_open) {
+                return false;
+            }
+
+            const auto info = ov_info(&this->vf, -1);
+            if((info == nullptr) || (info->channels <= 0) || (info->rate <= 0)) {
+                return false;
+            }
+            this->src_channel_count = info->channels;
+            this->src_buf.resize(SourceBufferFrameCount * this->src_channel_count);
+            return true;
+        }
+
+        bool RefillSource() {
+            u32 kept_frame_count = 0;
+            if(this->src_frame_count > 0) {
+                std::memmove(this->src_buf.data(), this->src_buf.data() + (this->src_frame_count - 1) * this->src_channel_count, this->src_channel_count * sizeof(s16));
+                this->src_pos -= this->src_frame_count - 1;
+                kept_frame_count = 1;
+            }
+
+            const auto frame_size = this->src_channel_count * sizeof(s16);
+            auto read_buf = reinterpret_cast<char*>(this->src_buf.data() + kept_frame_count * this->src_channel_count);
+            const auto read_size = static_cast<i32>((SourceBufferFrameCount - kept_frame_count) * frame_size);
+            long read_bytes = 0;
+            auto just_looped = false;
+            while(read_bytes <= 0) {
+                i32 bitstream;
+                read_bytes = ov_read(&this->vf, read_buf, read_size, &bitstream);
+                if(read_bytes == 0) {
+                    // Looping right here keeps the next frames in the same batch, so there's no gap at all
+                    if(this->loop && !just_looped && (ov_pcm_seek(&this->vf, 0) == 0)) {
+                        just_looped = true;
+                        continue;
+                    }
+                    break;
+                }
+                else if((read_bytes < 0) && (read_bytes != OV_HOLE)) {
+                    break;
+                }
+            }
+
+            if(read_bytes <= 0) {
+                this->ended = true;
+                return false;
+            }
+            this->src_frame_count = kept_frame_count + read_bytes / frame_size;
+            return true;
+        }
+
+        bool NextFrame(i32 &out_left, i32 &out_right) {
+            while((static_cast<u32>(this->src_pos) + 1) >= this->src_frame_count) {
+                if(this->ended || !this->RefillSource()) {
+                    return false;
+                }
+            }
+
+            // Linear interpolation, only needed if the track's rate isn't the mixer's
+            const auto src_idx = static_cast<u32>(this->src_pos);
+            const auto frac = this->src_pos - src_idx;
+            const auto cur_frame = this->src_buf.data() + src_idx * this->src_channel_count;
+            const auto next_frame = cur_frame + this->src_channel_count;
+            out_left = cur_frame[0] + static_cast<i32>((next_frame[0] - cur_frame[0]) * frac);
+            if(this->src_channel_count > 1) {
+                out_right = cur_frame[1] + static_cast<i32>((next_frame[1] - cur_frame[1]) * frac);
+            }
+            else {
+                out_right = out_left;
+            }
+            this->src_pos += this->src_step;
+            return true;
+        }
+    };
+
+    MusicPlayer::MusicPlayer(const u32 buffer_ms) : freq(0), channel_count(0), valid(false), decoder_running(false), ring_write_pos(0), ring_read_pos(0), playing(false), volume(MIX_MAX_VOLUME), underrun_count(0), underrun_sample_count(0), decoder_exit(false) {
+        mutexInit(&this->lock);
+        condvarInit(&this->cond_var);
+
+        u16 fmt = 0;
+        i32 channel_count = 0;
+        if(!Mix_QuerySpec(&this->freq, &fmt, &channel_count) || (fmt != AUDIO_S16SYS) || (channel_count < 1) || (channel_count > 2)) {
+            return;
+        }
+        this->channel_count = channel_count;
+
+        const auto ring_frame_count = std::max(static_cast<u32>(static_cast<u64>(this->freq) * buffer_ms / 1000), 2 * DecodeChunkFrameCount);
+        this->ring.resize(ring_frame_count * this->channel_count);
+        this->mix_buf.resize(DecodeChunkFrameCount * this->channel_count);
+
+        if(R_SUCCEEDED(threadCreate(&this->decoder_thread, DecoderMain, this, nullptr, DecoderStackSize, DecoderPriority, -2))) {
+            if(R_SUCCEEDED(threadStart(&this->decoder_thread))) {
+                this->decoder_running = true;
+            }
+            else {
+                threadClose(&this->decoder_thread);
+            }
+        }
+        if(!this->decoder_running) {
+            return;
+        }
+
+        Mix_HookMusic(MixCallback, this);
+        this->valid = true;
+    }
+
+    MusicPlayer::~MusicPlayer() {
+        if(this->valid) {
+            // Once this returns the callback is no longer running
+            Mix_HookMusic(nullptr, nullptr);
+        }
+
+        if(this->decoder_running) {
+            mutexLock(&this->lock);
+            this->decoder_exit = true;
+            condvarWakeAll(&this->cond_var);
+            mutexUnlock(&this->lock);
+
+            threadWaitForExit(&this->decoder_thread);
+            threadClose(&this->decoder_thread);
+        }
+    }
+
+    void MusicPlayer::MixCallback(void *player_ptr, u8 *stream, i32 stream_len) {
+        auto player = reinterpret_cast<MusicPlayer*>(player_ptr);
+        auto out_samples = reinterpret_cast<s16*>(stream);
+        const auto sample_count = static_cast<u64>(stream_len) / sizeof(s16);
+
+        const auto read_pos = player->ring_read_pos.load(std::memory_order_relaxed);
+        const auto write_pos = player->ring_write_pos.load(std::memory_order_acquire);
+        const auto copy_count = std::min(write_pos - read_pos, sample_count);
+        const auto vol = player->volume.load(std::memory_order_relaxed);
+        const auto ring_size = player->ring.size();
+        for(u64 i = 0; i < copy_count; i++) {
+            const auto sample = player->ring[(read_pos + i) % ring_size];
+            out_samples[i] = (vol == MIX_MAX_VOLUME) ? sample : static_cast<s16>((sample * vol) / MIX_MAX_VOLUME);
+        }
+        player->ring_read_pos.store(read_pos + copy_count, std::memory_order_release);
+
+        if(copy_count < sample_count) {
+            std::memset(out_samples + copy_count, 0, (sample_count - copy_count) * sizeof(s16));
+            if(player->playing.load(std::memory_order_relaxed)) {
+                player->underrun_count++;
+                player->underrun_sample_count += sample_count - copy_count;
+            }
+        }
+    }
+
+    void MusicPlayer::DecoderMain(void *player_ptr) {
+        auto player = reinterpret_cast<MusicPlayer*>(player_ptr);
+        const auto get_free_frame_count = [&]() -> u32 {
+            const auto used_sample_count = player->ring_write_pos.load(std::memory_order_relaxed) - player->ring_read_pos.load(std::memory_order_acquire);
+            return (player->ring.size() - used_sample_count) / player->channel_count;
+        };
+
+        while(true) {
+            mutexLock(&player->lock);
+            // The callback never touches the lock, so free space in the ring is polled
+            while(!player->decoder_exit && player->requests.empty() && (player->decks.empty() || (get_free_frame_count() < DecodeChunkFrameCount))) {
+                condvarWaitTimeout(&player->cond_var, &player->lock, DecoderWaitTimeoutNs);
+            }
+            if(player->decoder_exit) {
+                mutexUnlock(&player->lock);
+                break;
+            }
+            auto reqs = std::move(player->requests);
+            player->requests.clear();
+            mutexUnlock(&player->lock);
+
+            for(const auto &req : reqs) {
+                player->HandleRequest(req);
+            }
+
+            const auto free_frame_count = get_free_frame_count();
+            if(!player->decks.empty() && (free_frame_count > 0)) {
+                player->DecodeChunk(std::min(free_frame_count, DecodeChunkFrameCount));
+            }
+            player->playing = !player->decks.empty();
+        }
+    }
+
+    void MusicPlayer::HandleRequest(const PlayRequest &req) {
+        const auto fade_frame_count = static_cast<u64>(this->freq) * req.crossfade_ms / 1000;
+
+        std::unique_ptr<Deck> new_deck;
+        if(!req.stop) {
+            new_deck = std::make_unique<Deck>();
+            new_deck->loop = req.loop;
+            if(!new_deck->Open(req.path, req.preload)) {
+                return;
+            }
+            new_deck->src_step = static_cast<double>(ov_info(&new_deck->vf, -1)->rate) / this->freq;
+        }
+
+        // Playing decks fade out (or stop right away), and the new one fades in meanwhile
+        if(fade_frame_count == 0) {
+            this->decks.clear();
+        }
+        else {
+            for(auto &deck : this->decks) {
+                deck->gain_step = -1.0f / fade_frame_count;
+            }
+        }
+
+        if(new_deck) {
+            if(fade_frame_count > 0) {
+                new_deck->gain = 0.0f;
+                new_deck->gain_step = 1.0f / fade_frame_count;
+            }
+            this->decks.push_back(std::move(new_deck));
+        }
+        this->playing = !this->decks.empty();
+    }
+
+    void MusicPlayer::DecodeChunk(const u32 frame_count) {
+        std::fill(this->mix_buf.begin(), this->mix_buf.begin() + frame_count * this->channel_count, 0);
+        for(auto &deck : this->decks) {
+            for(u32 i = 0; i < frame_count; i++) {
+                i32 left;
+                i32 right;
+                if(!deck->NextFrame(left, right)) {
+                    break;
+                }
+
+                if(this->channel_count == 1) {
+                    this->mix_buf[i] += static_cast<i32>(((left + right) / 2) * deck->gain);
+                }
+                else {
+                    this->mix_buf[2 * i] += static_cast<i32>(left * deck->gain);
+                    this->mix_buf[2 * i + 1] += static_cast<i32>(right * deck->gain);
+                }
+
+                if(deck->gain_step != 0.0f) {
+                    deck->gain = std::clamp(deck->gain + deck->gain_step, 0.0f, 1.0f);
+                    if(deck->gain == 1.0f) {
+                        deck->gain_step = 0.0f;
+                    }
+                    else if(deck->gain == 0.0f) {
+                        // Faded out completely
+                        deck->ended = true;
+                        break;
+                    }
+                }
+            }
+        }
+        this->decks.erase(std::remove_if(this->decks.begin(), this->decks.end(), [](const std::unique_ptr<Deck> &deck) {
+            return deck->ended;
+        }), this->decks.end());
+
+        const auto write_pos = this->ring_write_pos.load(std::memory_order_relaxed);
+        const auto ring_size = this->ring.size();
+        for(u32 i = 0; i < frame_count * this->channel_count; i++) {
+            this->ring[(write_pos + i) % ring_size] = static_cast<s16>(std::clamp(this->mix_buf[i], -0x8000, 0x7FFF));
+        }
+        this->ring_write_pos.store(write_pos + frame_count * this->channel_count, std::memory_order_release);
+    }
+
+    void MusicPlayer::PushRequest(PlayRequest &&req) {
+        if(!this->valid) {
+            return;
+        }
+
+        mutexLock(&this->lock);
+        this->requests.push_back(std::move(req));
+        condvarWakeOne(&this->cond_var);
+        mutexUnlock(&this->lock);
+    }
+
+    void MusicPlayer::Play(const std::string &path, const bool loop, const u32 crossfade_ms, const bool preload) {
+        // Opened on the decoder thread, so that a slow SD card never stalls the caller
+        this->PushRequest({ path, loop, crossfade_ms, preload, false });
+    }
+
+    void MusicPlayer::Stop(const u32 fade_out_ms) {
+        this->PushRequest({ {}, false, fade_out_ms, false, true });
+    }
+
+    MusicPlayerStatistics MusicPlayer::GetStatistics() {
+        return { this->underrun_count.load(), this->underrun_sample_count.load() };
+    }
+
+    void MusicPlayer::ResetStatistics() {
+        this->underrun_count = 0;
+        this->underrun_sample_count = 0;
+    }
+
+}
@@ -1,4 +1,5 @@
 #include <pu/audio/audio_Sfx.hpp>
+#include <pu/audio/audio_Latency.hpp>
 
 namespace pu::audio {
 
@@ -7,7 +8,7 @@ namespace pu::audio {
     }
 
     void PlaySfx(Sfx sfx) {
-        Mix_PlayChannel(-1, sfx, 0);
+        PlayChunk(-1, sfx);
     }
 
     void DestroySfx(Sfx &sfx) {
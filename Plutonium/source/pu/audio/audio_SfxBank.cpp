@@ -0,0 +1,137 @@
+#include <pu/audio/audio_SfxBank.hpp>
+#include <pu/audio/audio_Latency.hpp>
+
+namespace pu::audio {
+
+    namespace {
+
+        // Reserved channels are always the first ones, so each bank takes the range right after the previous bank's
+        i32 g_ReservedChannelCount = 0;
+
+    }
+
+    SfxBank::SfxBank(const u32 voice_count) : trigger_seq(0), stats() {
+        if(voice_count == 0) {
+            return;
+        }
+
+        const auto first_channel = g_ReservedChannelCount;
+        g_ReservedChannelCount += voice_count;
+
+        // Leave the usual amount of channels for everything else
+        const auto needed_channel_count = g_ReservedChannelCount + MIX_CHANNELS;
+        if(Mix_AllocateChannels(-1) < needed_channel_count) {
+            Mix_AllocateChannels(needed_channel_count);
+        }
+        Mix_ReserveChannels(g_ReservedChannelCount);
+
+        this->voices.reserve(voice_count);
+        for(u32 i = 0; i < voice_count; i++) {
+            this->voices.push_back({ static_cast<i32>(first_channel + i), InvalidSfxId, 0, 0 });
+        }
+    }
+
+    SfxBank::~SfxBank() {
+        this->StopAll();
+        for(auto &sound : this->sounds) {
+            Mix_FreeChunk(sound.chunk);
+        }
+
+        // Only the last bank's channels can be given back, since reserved ones must come first
+        if(!this->voices.empty() && ((this->voices.back().channel + 1) == g_ReservedChannelCount)) {
+            g_ReservedChannelCount = this->voices.front().channel;
+            Mix_ReserveChannels(g_ReservedChannelCount);
+        }
+    }
+
+    SfxId SfxBank::AddSound(const std::string &name, Mix_Chunk *chunk, const u8 priority) {
+        if(chunk == nullptr) {
+            return InvalidSfxId;
+        }
+
+        const auto sfx_id = static_cast<SfxId>(this->sounds.size());
+        this->sounds.push_back({ chunk, priority });
+        this->sound_table[name] = sfx_id;
+        return sfx_id;
+    }
+
+    SfxId SfxBank::Load(const std::string &path, const u8 priority) {
+        const auto sfx_id = this->Find(path);
+        if(sfx_id != InvalidSfxId) {
+            return sfx_id;
+        }
+
+        return this->AddSound(path, Mix_LoadWAV(path.c_str()), priority);
+    }
+
+    SfxId SfxBank::LoadFromMemory(const std::string &name, const void *data, const size_t data_size, const u8 priority) {
+        const auto sfx_id = this->Find(name);
+        if(sfx_id != InvalidSfxId) {
+            return sfx_id;
+        }
+
+        auto rw = SDL_RWFromConstMem(data, static_cast<i32>(data_size));
+        if(rw == nullptr) {
+            return InvalidSfxId;
+        }
+        return this->AddSound(name, Mix_LoadWAV_RW(rw, 1), priority);
+    }
+
+    SfxId SfxBank::Find(const std::string &path_or_name) {
+        auto it = this->sound_table.find(path_or_name);
+        if(it != this->sound_table.end()) {
+            return it->second;
+        }
+        else {
+            return InvalidSfxId;
+        }
+    }
+
+    bool SfxBank::Trigger(const SfxId sfx_id, const i32 volume) {
+        if((sfx_id >= this->sounds.size()) || this->voices.empty()) {
+            return false;
+        }
+
+        // A free voice if any, otherwise the oldest one with the lowest priority, as long as it's not above the new sound's
+        const auto &sound = this->sounds.at(sfx_id);
+        Voice *target_voice = nullptr;
+        auto steals = false;
+        for(auto &voice : this->voices) {
+            if(!Mix_Playing(voice.channel)) {
+                target_voice = &voice;
+                steals = false;
+                break;
+            }
+            if((voice.priority <= sound.priority) && ((target_voice == nullptr) || (voice.priority < target_voice->priority) || ((voice.priority == target_voice->priority) && (voice.trigger_seq < target_voice->trigger_seq)))) {
+                target_voice = &voice;
+                steals = true;
+            }
+        }
+
+        this->stats.triggered_count++;
+        if(target_voice == nullptr) {
+            this->stats.dropped_count++;
+            return false;
+        }
+        if(steals) {
+            this->stats.stolen_count++;
+        }
+
+        // Playing on a busy channel halts whatever it was playing
+        Mix_Volume(target_voice->channel, volume);
+        if(PlayChunk(target_voice->channel, sound.chunk) < 0) {
+            return false;
+        }
+        target_voice->sfx_id = sfx_id;
+        target_voice->priority = sound.priority;
+        target_voice->trigger_seq = this->trigger_seq++;
+        return true;
+    }
+
+    void SfxBank::StopAll() {
+        for(auto &voice : this->voices) {
+            Mix_HaltChannel(voice.channel);
+        }
+    }
+
+}
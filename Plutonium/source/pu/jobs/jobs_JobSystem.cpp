@@ -0,0 +1,340 @@
+#include <pu/jobs/jobs_JobSystem.hpp>
+#include <deque>
+#include <vector>
+#include <chrono>
+
+namespace pu::jobs {
+
+    namespace {
+
+        using Clock = std::chrono::steady_clock;
+
+        // Larger than other threads in the library, since jobs may decode images or parse files
+        constexpr size_t WorkerStackSize = 0x40000;
+        // Slightly below the usual main thread priority, so that workers never delay a frame on a shared core
+        constexpr int WorkerPriority = 0x2D;
+
+        constexpr u32 PriorityCount = static_cast<u32>(JobPriority::Count);
+
+        struct Job {
+            JobFunction job_fn;
+            JobFunction cont_fn;
+            CancellationToken token;
+            std::shared_ptr<JobHandle::State> state;
+            Clock::time_point submit_time;
+        };
+
+        struct Worker {
+            Thread thread;
+            // Guards the queues, which any worker may steal from
+            Mutex lock;
+            std::deque<Job> queues[PriorityCount];
+        };
+
+        std::vector<std::unique_ptr<Worker>> g_Workers;
+        std::atomic_bool g_WorkersExit = false;
+        std::atomic<u32> g_NextWorkerIndex = 0;
+        thread_local i32 g_CurrentWorkerIndex = -1;
+
+        // Idle workers sleep until jobs are pending, submitting only wakes one up if any is sleeping
+        Mutex g_IdleLock = {};
+        CondVar g_IdleCondVar = {};
+        std::atomic<i32> g_PendingJobCount = 0;
+        std::atomic<u32> g_IdleWorkerCount = 0;
+
+        // Waiters are woken whenever a job finishes, but only if there are any
+        Mutex g_FinishLock = {};
+        CondVar g_FinishCondVar = {};
+        std::atomic<u32> g_WaiterCount = 0;
+
+        Mutex g_ContinuationLock = {};
+        std::vector<JobFunction> g_Continuations;
+        std::vector<JobFunction> g_RunningContinuations;
+
+        std::atomic<u64> g_SubmittedCount = 0;
+        std::atomic<u64> g_ExecutedCount = 0;
+        std::atomic<u64> g_StolenCount = 0;
+        std::atomic<u64> g_CancelledCount = 0;
+        std::atomic<u64> g_MaxQueueLatencyUs = 0;
+        std::atomic<u64> g_TotalQueueLatencyUs = 0;
+        std::atomic<u64> g_TotalRunTimeUs = 0;
+
+        inline u64 GetElapsedUs(const Clock::time_point start_time, const Clock::time_point end_time) {
+            return std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
+        }
+
+        void FinishJob(Job &job, const JobHandle::Status status) {
+            job.state->status = status;
+            if(g_WaiterCount > 0) {
+                mutexLock(&g_FinishLock);
+                condvarWakeAll(&g_FinishCondVar);
+                mutexUnlock(&g_FinishLock);
+            }
+        }
+
+        void RunJob(Job &job) {
+            if(job.token.IsCancelled()) {
+                g_CancelledCount++;
+                FinishJob(job, JobHandle::Status::Cancelled);
+                return;
+            }
+
+            const auto start_time = Clock::now();
+            const auto queue_latency_us = GetElapsedUs(job.submit_time, start_time);
+            g_TotalQueueLatencyUs += queue_latency_us;
+            auto max_queue_latency_us = g_MaxQueueLatencyUs.load();
+            while((queue_latency_us > max_queue_latency_us) && !g_MaxQueueLatencyUs.compare_exchange_weak(max_queue_latency_us, queue_latency_us));
+
+            job.state->status = JobHandle::Status::Running;
+            job.job_fn();
+            g_TotalRunTimeUs += GetElapsedUs(start_time, Clock::now());
+            g_ExecutedCount++;
+
+            // Whatever a job cancelled midway produced is never handed over
+            if(job.token.IsCancelled()) {
+                g_CancelledCount++;
+                FinishJob(job, JobHandle::Status::Cancelled);
+                return;
+            }
+            if(job.cont_fn) {
+                PostToUiThread(std::move(job.cont_fn));
+            }
+            FinishJob(job, JobHandle::Status::Done);
+        }
+
+        // Both the owner and thieves take the oldest job, since UI work cares more about latency than about cache locality
+        bool TakeJob(const u32 worker_idx, Job &out_job) {
+            const auto worker_count = g_Workers.size();
+            for(i32 prio = PriorityCount - 1; prio >= 0; prio--) {
+                for(u32 i = 0; i < worker_count; i++) {
+                    auto &worker = g_Workers.at((worker_idx + i) % worker_count);
+                    auto &queue = worker->queues[prio];
+                    mutexLock(&worker->lock);
+                    if(!queue.empty()) {
+                        out_job = std::move(queue.front());
+                        queue.pop_front();
+                        mutexUnlock(&worker->lock);
+
+                        g_PendingJobCount--;
+                        if(i > 0) {
+                            g_StolenCount++;
+                        }
+                        return true;
+                    }
+                    mutexUnlock(&worker->lock);
+                }
+            }
+            return false;
+        }
+
+        void WorkerMain(void *worker_idx_ptr) {
+            const auto worker_idx = static_cast<u32>(reinterpret_cast<uintptr_t>(worker_idx_ptr));
+            g_CurrentWorkerIndex = worker_idx;
+
+            while(!g_WorkersExit) {
+                Job job;
+                if(TakeJob(worker_idx, job)) {
+                    RunJob(job);
+                    continue;
+                }
+
+                mutexLock(&g_IdleLock);
+                g_IdleWorkerCount++;
+                while((g_PendingJobCount <= 0) && !g_WorkersExit) {
+                    condvarWait(&g_IdleCondVar, &g_IdleLock);
+                }
+                g_IdleWorkerCount--;
+                mutexUnlock(&g_IdleLock);
+            }
+        }
+
+        std::vector<int> GetWorkerCores() {
+            // Prefer the cores available to the process other than the one running the UI
+            std::vector<int> cores;
+            u64 core_mask = 0;
+            if(R_SUCCEEDED(svcGetInfo(&core_mask, InfoType_CoreMask, CUR_PROCESS_HANDLE, 0))) {
+                const auto cur_core = static_cast<int>(svcGetCurrentProcessorNumber());
+                for(int i = 0; i < 64; i++) {
+                    if((core_mask & BITL(i)) && (i != cur_core)) {
+                        cores.push_back(i);
+                    }
+                }
+            }
+            if(cores.empty()) {
+                cores.push_back(-2);
+            }
+            return cores;
+        }
+
+    }
+
+    void JobHandle::Wait() const {
+        if(!this->state) {
+            return;
+        }
+
+        g_WaiterCount++;
+        mutexLock(&g_FinishLock);
+        while(!this->IsFinished()) {
+            condvarWait(&g_FinishCondVar, &g_FinishLock);
+        }
+        mutexUnlock(&g_FinishLock);
+        g_WaiterCount--;
+    }
+
+    bool Initialize(const u32 worker_count) {
+        if(!g_Workers.empty()) {
+            return true;
+        }
+
+        mutexInit(&g_IdleLock);
+        condvarInit(&g_IdleCondVar);
+        mutexInit(&g_FinishLock);
+        condvarInit(&g_FinishCondVar);
+        g_WorkersExit = false;
+        g_PendingJobCount = 0;
+        g_IdleWorkerCount = 0;
+
+        // Every worker's queues need to exist before any of them starts stealing
+        for(u32 i = 0; i < worker_count; i++) {
+            auto worker = std::make_unique<Worker>();
+            mutexInit(&worker->lock);
+            g_Workers.push_back(std::move(worker));
+        }
+
+        const auto cores = GetWorkerCores();
+        u32 started_count = 0;
+        for(u32 i = 0; i < worker_count; i++) {
+            auto &worker = g_Workers.at(i);
+            if(R_FAILED(threadCreate(&worker->thread, WorkerMain, reinterpret_cast<void*>(static_cast<uintptr_t>(i)), nullptr, WorkerStackSize, WorkerPriority, cores.at(i % cores.size())))) {
+                break;
+            }
+            if(R_FAILED(threadStart(&worker->thread))) {
+                threadClose(&worker->thread);
+                break;
+            }
+            started_count++;
+        }
+
+        // Workers which failed to start never had any jobs queued, and their indices are past the running ones
+        if(started_count < worker_count) {
+            g_WorkersExit = true;
+            mutexLock(&g_IdleLock);
+            condvarWakeAll(&g_IdleCondVar);
+            mutexUnlock(&g_IdleLock);
+            for(u32 i = 0; i < started_count; i++) {
+                threadWaitForExit(&g_Workers.at(i)->thread);
+                threadClose(&g_Workers.at(i)->thread);
+            }
+            g_Workers.clear();
+            return false;
+        }
+        return true;
+    }
+
+    void Finalize() {
+        // Even without workers, since inline jobs post them too (running ones are cleared once RunContinuations returns)
+        mutexLock(&g_ContinuationLock);
+        g_Continuations.clear();
+        mutexUnlock(&g_ContinuationLock);
+
+        if(g_Workers.empty()) {
+            return;
+        }
+
+        mutexLock(&g_IdleLock);
+        g_WorkersExit = true;
+        condvarWakeAll(&g_IdleCondVar);
+        mutexUnlock(&g_IdleLock);
+
+        for(auto &worker : g_Workers) {
+            threadWaitForExit(&worker->thread);
+            threadClose(&worker->thread);
+        }
+        for(auto &worker : g_Workers) {
+            for(auto &queue : worker->queues) {
+                for(auto &job : queue) {
+                    g_CancelledCount++;
+                    FinishJob(job, JobHandle::Status::Cancelled);
+                }
+            }
+        }
+        g_Workers.clear();
+        g_PendingJobCount = 0;
+    }
+
+    bool IsInitialized() {
+        return !g_Workers.empty();
+    }
+
+    u32 GetWorkerCount() {
+        return g_Workers.size();
+    }
+
+    JobHandle Submit(JobFunction job_fn, JobFunction cont_fn, const JobPriority prio, CancellationToken token) {
+        auto state = std::make_shared<JobHandle::State>();
+        Job job = { std::move(job_fn), std::move(cont_fn), token, state, Clock::now() };
+        g_SubmittedCount++;
+
+        if(g_Workers.empty()) {
+            RunJob(job);
+            return JobHandle(state, token);
+        }
+
+        // Jobs submitted from a job stay on its worker, others are spread evenly
+        const auto worker_idx = (g_CurrentWorkerIndex >= 0) ? static_cast<u32>(g_CurrentWorkerIndex) : (g_NextWorkerIndex++ % g_Workers.size());
+        auto &worker = g_Workers.at(worker_idx);
+        mutexLock(&worker->lock);
+        worker->queues[static_cast<u32>(prio)].push_back(std::move(job));
+        mutexUnlock(&worker->lock);
+
+        g_PendingJobCount++;
+        if(g_IdleWorkerCount > 0) {
+            mutexLock(&g_IdleLock);
+            condvarWakeOne(&g_IdleCondVar);
+            mutexUnlock(&g_IdleLock);
+        }
+        return JobHandle(state, token);
+    }
+
+    void PostToUiThread(JobFunction fn) {
+        mutexLock(&g_ContinuationLock);
+        g_Continuations.push_back(std::move(fn));
+        mutexUnlock(&g_ContinuationLock);
+    }
+
+    void RunContinuations() {
+        // Swapped out first, so continuations may post more of them (which run the next frame)
+        mutexLock(&g_ContinuationLock);
+        g_RunningContinuations.swap(g_Continuations);
+        mutexUnlock(&g_ContinuationLock);
+
+        for(auto &fn : g_RunningContinuations) {
+            fn();
+        }
+        g_RunningContinuations.clear();
+    }
+
+    JobStatistics GetStatistics() {
+        return {
+            .submitted_count = g_SubmittedCount,
+            .executed_count = g_ExecutedCount,
+            .stolen_count = g_StolenCount,
+            .cancelled_count = g_CancelledCount,
+            .max_queue_latency_us = g_MaxQueueLatencyUs,
+            .total_queue_latency_us = g_TotalQueueLatencyUs,
+            .total_run_time_us = g_TotalRunTimeUs
+        };
+    }
+
+    void ResetStatistics() {
+        g_SubmittedCount = 0;
+        g_ExecutedCount = 0;
+        g_StolenCount = 0;
+        g_CancelledCount = 0;
+        g_MaxQueueLatencyUs = 0;
+        g_TotalQueueLatencyUs = 0;
+        g_TotalRunTimeUs = 0;
+    }
+
+}
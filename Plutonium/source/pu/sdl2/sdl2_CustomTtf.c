@@ -30,9 +30,13 @@
 #include FT_STROKER_H
 #include FT_GLYPH_H
 #include FT_TRUETYPE_IDS_H
+#include FT_SIZES_H
 
 #include <pu/sdl2/sdl2_CustomTtf.h>
 
+/* Glyph compositing row kernels, kept apart so they can be tested on their own */
+#include "sdl2_CustomTtfComposite.h"
+
 /* FIXME: Right now we assume the gray-scale renderer Freetype is using
    supports 256 shades of gray, but we should instead key off of num_grays
    in the result FT_Bitmap after the FT_Render_Glyph() call. */
@@ -61,11 +65,45 @@ typedef struct cached_glyph {
     Uint16 cached;
 } c_glyph;
 
+/* Cached glyph metrics, kept apart from the glyph cache so that sizing
+   text never has to reload (or evict) a rendered glyph */
+typedef struct cached_metrics {
+    int stored;
+    Uint16 cached;
+    FT_UInt index;
+    int minx;
+    int maxx;
+    int miny;
+    int maxy;
+    int advance;
+} c_metrics;
+
+/* Cached kerning of a glyph pair */
+typedef struct cached_kerning {
+    FT_UInt prev_index;
+    FT_UInt index;
+    int delta;
+} c_kerning;
+
+/* Kerning pairs are cached in an open addressing table, which is just
+   cleared once it gets too full (most text keeps reusing a few pairs) */
+#define KERNING_CACHE_SIZE      1024 /* must be a power of two */
+#define KERNING_CACHE_MAX_USED  (KERNING_CACHE_SIZE * 3 / 4)
+
 /* The structure used to hold internal font information */
 struct _TTF_Font {
     /* Freetype2 maintains all sorts of useful info itself */
     FT_Face face;
 
+    /* Size object of this font, the face may be shared with fonts of other sizes */
+    FT_Size size;
+
+    /* Custom - memory the font was opened from (and which face of it) and its requested size, used to key the persistent glyph cache */
+    const void *src_mem;
+    Uint64 src_mem_hash;
+    long src_face_index;
+    int ptsize;
+
     /* We'll cache these ourselves */
     int height;
     int ascent;
@@ -92,6 +130,13 @@ struct _TTF_Font {
     c_glyph *current;
     c_glyph cache[257]; /* 257 is a prime */
 
+    /* Cache for glyph metrics only, used when sizing text */
+    c_metrics metrics_cache[509]; /* 509 is a prime */
+
+    /* Cache for kerning pairs, allocated on first use */
+    c_kerning *kerning_cache;
+    int kerning_cache_used;
+
     /* We are responsible for closing the font stream */
     SDL_RWops *src;
     int freesrc;
@@ -120,6 +165,93 @@ struct _TTF_Font {
 
 /* The FreeType font engine/library */
 static FT_Library library;
+
+/* Faces opened from memory, shared by every font opened from the same buffer.
+   FreeType reference counts the faces themselves, entries unlink themselves
+   from this list when their face is finally destroyed. */
+typedef struct _c_shared_face {
+    const void *mem;
+    size_t size;
+    long index;
+    FT_Face face;
+    /* Fingerprint of the buffer for the persistent glyph cache, computed once here */
+    Uint64 hash;
+    struct _c_shared_face *next;
+} c_shared_face;
+
+static c_shared_face *shared_faces = NULL;
+
+/* Since faces may be shared by fonts used from different threads (like the
+   glyph cache pre-warming one), everything touching FreeType is serialized */
+static SDL_mutex *library_lock = NULL;
+
+static __inline__ void TTF_lockLibrary(void)
+{
+    if ( library_lock ) {
+        SDL_LockMutex( library_lock );
+    }
+}
+
+static __inline__ void TTF_unlockLibrary(void)
+{
+    if ( library_lock ) {
+        SDL_UnlockMutex( library_lock );
+    }
+}
+
+static void Flush_KerningCache(TTF_Font *font)
+{
+    if ( font->kerning_cache ) {
+        memset( font->kerning_cache, 0, KERNING_CACHE_SIZE * sizeof(c_kerning) );
+    }
+    font->kerning_cache_used = 0;
+}
+
+/* Makes the size object of this font the active one of its (maybe shared) face */
+static __inline__ void TTF_activateSize(TTF_Font *font)
+{
+    if ( font->size && (font->face->size != font->size) ) {
+        FT_Activate_Size( font->size );
+    }
+}
+
+static int TTF_getKerning(TTF_Font *font, FT_UInt prev_index, FT_UInt index)
+{
+    FT_Vector delta;
+    c_kerning *entry = NULL;
+
+    /* Glyph index zero is never kerned, so a zero prev_index marks empty slots */
+    if ( prev_index && (font->kerning_cache || (font->kerning_cache = (c_kerning*)calloc(KERNING_CACHE_SIZE, sizeof(c_kerning)))) ) {
+        unsigned int slot = ((prev_index * 0x9E3779B1u) ^ index) & (KERNING_CACHE_SIZE - 1);
+        for ( ; ; ) {
+            entry = &font->kerning_cache[slot];
+            if ( !entry->prev_index ) {
+                break;
+            }
+            if ( entry->prev_index == prev_index && entry->index == index ) {
+                return entry->delta;
+            }
+            slot = (slot + 1) & (KERNING_CACHE_SIZE - 1);
+        }
+    }
+
+    TTF_lockLibrary();
+    TTF_activateSize( font );
+    FT_Get_Kerning( font->face, prev_index, index, ft_kerning_default, &delta );
+    TTF_unlockLibrary();
+
+    if ( entry ) {
+        if ( font->kerning_cache_used >= KERNING_CACHE_MAX_USED ) {
+            Flush_KerningCache( font );
+            return (delta.x >> 6);
+        }
+        entry->prev_index = prev_index;
+        entry->index = index;
+        entry->delta = delta.x >> 6;
+        ++font->kerning_cache_used;
+    }
+    return (delta.x >> 6);
+}
 static int TTF_initialized = 0;
 static int TTF_byteswapped = 0;
 
@@ -216,6 +348,11 @@ static void TTF_initLineMectrics(const TTF_Font *font, const SDL_Surface *textbu
     *pheight = height;
 }
 
+/* Number of pixels of a row starting at dst that still lie within the surface */
+#define TTF_CLAMP_ROW(dst, dst_check, width) \
+    (((dst) >= (dst_check)) ? 0 : \
+     (((dst_check) - (dst)) < (width)) ? (int)((dst_check) - (dst)) : (width))
+
 /* Draw a solid line of underline_height (+ optional outline)
    at the given row. The row value must take the
    outline into account.
@@ -342,6 +479,8 @@ int TTF_Init( void )
         if ( error ) {
             TTF_SetFTError("Couldn't init FreeType engine", error);
             status = -1;
+        } else {
+            library_lock = SDL_CreateMutex();
         }
     }
     if ( status == 0 ) {
@@ -367,75 +506,15 @@ static unsigned long RWread(
     return (unsigned long)SDL_RWread( src, buffer, 1, (int)count );
 }
 
-TTF_Font* TTF_OpenFontIndexRW( SDL_RWops *src, int freesrc, int ptsize, long index )
+/* Sets the size of a freshly opened font and caches its metrics and style */
+static int TTF_initFont( TTF_Font *font, int ptsize )
 {
-    TTF_Font* font;
     FT_Error error;
     FT_Face face;
     FT_Fixed scale;
-    FT_Stream stream;
     FT_CharMap found;
-    Sint64 position;
     int i;
 
-    if ( ! TTF_initialized ) {
-        TTF_SetError( "Library not initialized" );
-        if ( src && freesrc ) {
-            SDL_RWclose( src );
-        }
-        return NULL;
-    }
-
-    if ( ! src ) {
-        TTF_SetError( "Passed a NULL font source" );
-        return NULL;
-    }
-
-    /* Check to make sure we can seek in this stream */
-    position = SDL_RWtell(src);
-    if ( position < 0 ) {
-        TTF_SetError( "Can't seek in stream" );
-        if ( freesrc ) {
-            SDL_RWclose( src );
-        }
-        return NULL;
-    }
-
-    font = (TTF_Font*) malloc(sizeof *font);
-    if ( font == NULL ) {
-        TTF_SetError( "Out of memory" );
-        if ( freesrc ) {
-            SDL_RWclose( src );
-        }
-        return NULL;
-    }
-    memset(font, 0, sizeof(*font));
-
-    font->src = src;
-    font->freesrc = freesrc;
-
-    stream = (FT_Stream)malloc(sizeof(*stream));
-    if ( stream == NULL ) {
-        TTF_SetError( "Out of memory" );
-        TTF_CloseFont( font );
-        return NULL;
-    }
-    memset(stream, 0, sizeof(*stream));
-
-    stream->read = RWread;
-    stream->descriptor.pointer = src;
-    stream->pos = (unsigned long)position;
-    stream->size = (unsigned long)(SDL_RWsize(src) - position);
-
-    font->args.flags = FT_OPEN_STREAM;
-    font->args.stream = stream;
-
-    error = FT_Open_Face( library, &font->args, index, &font->face );
-    if ( error ) {
-        TTF_SetFTError( "Couldn't load font file", error );
-        TTF_CloseFont( font );
-        return NULL;
-    }
     face = font->face;
 
     /* Set charmap for loaded font */
@@ -461,8 +540,7 @@ TTF_Font* TTF_OpenFontIndexRW( SDL_RWops *src, int freesrc, int ptsize, long ind
         error = FT_Set_Char_Size( font->face, 0, ptsize * 64, 0, 0 );
         if ( error ) {
             TTF_SetFTError( "Couldn't set font size", error );
-            TTF_CloseFont( font );
-            return NULL;
+            return -1;
         }
 
         /* Get the scalable font metrics for this font */
@@ -487,8 +565,7 @@ TTF_Font* TTF_OpenFontIndexRW( SDL_RWops *src, int freesrc, int ptsize, long ind
                 face->available_sizes[ptsize].height );
         if ( error ) {
             TTF_SetFTError( "Couldn't set font size", error );
-            TTF_CloseFont( font );
-            return NULL;
+            return -1;
         }
 
         /* With non-scalale fonts, Freetype2 likes to fill many of the
@@ -538,6 +615,84 @@ TTF_Font* TTF_OpenFontIndexRW( SDL_RWops *src, int freesrc, int ptsize, long ind
     font->glyph_italics = 0.207f;
     font->glyph_italics *= font->height;
 
+    return 0;
+}
+
+TTF_Font* TTF_OpenFontIndexRW( SDL_RWops *src, int freesrc, int ptsize, long index )
+{
+    TTF_Font* font;
+    FT_Error error;
+    FT_Stream stream;
+    Sint64 position;
+
+    if ( ! TTF_initialized ) {
+        TTF_SetError( "Library not initialized" );
+        if ( src && freesrc ) {
+            SDL_RWclose( src );
+        }
+        return NULL;
+    }
+
+    if ( ! src ) {
+        TTF_SetError( "Passed a NULL font source" );
+        return NULL;
+    }
+
+    /* Check to make sure we can seek in this stream */
+    position = SDL_RWtell(src);
+    if ( position < 0 ) {
+        TTF_SetError( "Can't seek in stream" );
+        if ( freesrc ) {
+            SDL_RWclose( src );
+        }
+        return NULL;
+    }
+
+    font = (TTF_Font*) malloc(sizeof *font);
+    if ( font == NULL ) {
+        TTF_SetError( "Out of memory" );
+        if ( freesrc ) {
+            SDL_RWclose( src );
+        }
+        return NULL;
+    }
+    memset(font, 0, sizeof(*font));
+
+    font->src = src;
+    font->freesrc = freesrc;
+
+    stream = (FT_Stream)malloc(sizeof(*stream));
+    if ( stream == NULL ) {
+        TTF_SetError( "Out of memory" );
+        TTF_CloseFont( font );
+        return NULL;
+    }
+    memset(stream, 0, sizeof(*stream));
+
+    stream->read = RWread;
+    stream->descriptor.pointer = src;
+    stream->pos = (unsigned long)position;
+    stream->size = (unsigned long)(SDL_RWsize(src) - position);
+
+    font->args.flags = FT_OPEN_STREAM;
+    font->args.stream = stream;
+
+    TTF_lockLibrary();
+    error = FT_Open_Face( library, &font->args, index, &font->face );
+    if ( error ) {
+        TTF_unlockLibrary();
+        TTF_SetFTError( "Couldn't load font file", error );
+        TTF_CloseFont( font );
+        return NULL;
+    }
+
+    if ( TTF_initFont( font, ptsize ) < 0 ) {
+        TTF_unlockLibrary();
+        TTF_CloseFont( font );
+        return NULL;
+    }
+    TTF_unlockLibrary();
+
     return font;
 }
 
@@ -561,6 +716,114 @@ TTF_Font* TTF_OpenFont( const char *file, int ptsize )
     return TTF_OpenFontIndex(file, ptsize, 0);
 }
 
+static void Release_SharedFace( void *object )
+{
+    FT_Face face = (FT_Face)object;
+    c_shared_face **link = &shared_faces;
+
+    while ( *link ) {
+        if ( (*link)->face == face ) {
+            c_shared_face *shared = *link;
+            *link = shared->next;
+            free( shared );
+            return;
+        }
+        link = &(*link)->next;
+    }
+}
+
+TTF_Font* TTF_OpenFontIndexMem( const void *mem, size_t size, int ptsize, long index )
+{
+    TTF_Font* font;
+    FT_Error error;
+    c_shared_face *shared;
+
+    if ( ! TTF_initialized ) {
+        TTF_SetError( "Library not initialized" );
+        return NULL;
+    }
+
+    if ( ! mem || ! size ) {
+        TTF_SetError( "Passed a NULL font source" );
+        return NULL;
+    }
+
+    font = (TTF_Font*) malloc(sizeof *font);
+    if ( font == NULL ) {
+        TTF_SetError( "Out of memory" );
+        return NULL;
+    }
+    memset(font, 0, sizeof(*font));
+    font->src_mem = mem;
+    font->src_face_index = index;
+    font->ptsize = ptsize;
+
+    TTF_lockLibrary();
+
+    /* Reuse the face if this buffer was already opened, otherwise read it in place */
+    for ( shared = shared_faces; shared; shared = shared->next ) {
+        if ( shared->mem == mem && shared->size == size && shared->index == index ) {
+            break;
+        }
+    }
+    if ( shared ) {
+        FT_Reference_Face( shared->face );
+        font->face = shared->face;
+        font->src_mem_hash = shared->hash;
+    } else {
+        shared = (c_shared_face*) malloc(sizeof *shared);
+        if ( shared == NULL ) {
+            TTF_unlockLibrary();
+            TTF_SetError( "Out of memory" );
+            free( font );
+            return NULL;
+        }
+
+        error = FT_New_Memory_Face( library, (const FT_Byte*)mem, (FT_Long)size, index, &font->face );
+        if ( error ) {
+            TTF_unlockLibrary();
+            TTF_SetFTError( "Couldn't load font file", error );
+            free( shared );
+            free( font );
+            return NULL;
+        }
+
+        shared->mem = mem;
+        shared->size = size;
+        shared->index = index;
+        shared->face = font->face;
+        shared->hash = TTF_CppWrap_ComputeFontHash( mem, size );
+        font->src_mem_hash = shared->hash;
+        shared->next = shared_faces;
+        shared_faces = shared;
+        font->face->generic.finalizer = Release_SharedFace;
+    }
+
+    /* Each font gets its own size object on the shared face */
+    error = FT_New_Size( font->face, &font->size );
+    if ( error ) {
+        TTF_unlockLibrary();
+        TTF_SetFTError( "Couldn't create font size", error );
+        TTF_CloseFont( font );
+        return NULL;
+    }
+    TTF_activateSize( font );
+
+    if ( TTF_initFont( font, ptsize ) < 0 ) {
+        TTF_unlockLibrary();
+        TTF_CloseFont( font );
+        return NULL;
+    }
+    TTF_unlockLibrary();
+
+    return font;
+}
+
+TTF_Font* TTF_OpenFontMem( const void *mem, size_t size, int ptsize )
+{
+    return TTF_OpenFontIndexMem(mem, size, ptsize, 0);
+}
+
 static void Flush_Glyph( c_glyph* glyph )
 {
     glyph->stored = 0;
@@ -587,9 +850,12 @@ static void Flush_Cache( TTF_Font* font )
         }
 
     }
+
+    memset( font->metrics_cache, 0, sizeof( font->metrics_cache ) );
+    Flush_KerningCache( font );
 }
 
-static FT_Error Load_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want )
+static FT_Error Render_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want )
 {
     FT_Face face;
     FT_Error error;
@@ -602,6 +868,7 @@ static FT_Error Load_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want
     }
 
     face = font->face;
+    TTF_activateSize( font );
 
     /* Load the glyph */
     if ( ! cached->index ) {
@@ -903,6 +1170,96 @@ static FT_Error Load_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want
     return 0;
 }
 
+static void Fill_CachedGlyphKey( TTF_Font* font, Uint16 ch, TTF_CachedGlyphKey* key )
+{
+    key->src_hash = font->src_mem_hash;
+    key->face_index = (int)font->src_face_index;
+    key->ptsize = font->ptsize;
+    key->style = font->style;
+    key->outline = font->outline;
+    key->hinting = font->hinting;
+    key->ch = ch;
+}
+
+/* Takes the glyph from the persistent glyph cache, if present there */
+static int Load_CachedGlyph( TTF_Font* font, Uint16 ch, c_glyph* cached )
+{
+    TTF_CachedGlyphKey key;
+    TTF_CachedGlyphInfo info;
+    const Uint8 *pixmap = NULL;
+    FT_Bitmap *dst = &cached->pixmap;
+
+    Fill_CachedGlyphKey( font, ch, &key );
+    if ( !TTF_CppWrap_FindCachedGlyph( &key, &info, &pixmap ) ) {
+        return 0;
+    }
+
+    memset( dst, 0, sizeof( *dst ) );
+    dst->width = info.width;
+    dst->rows = info.rows;
+    dst->pitch = info.pitch;
+    dst->pixel_mode = FT_PIXEL_MODE_GRAY;
+    dst->num_grays = NUM_GRAYS;
+    if ( dst->rows != 0 ) {
+        dst->buffer = (unsigned char *)malloc( dst->pitch * dst->rows );
+        if ( !dst->buffer ) {
+            return 0;
+        }
+        memcpy( dst->buffer, pixmap, dst->pitch * dst->rows );
+    }
+
+    cached->index = info.index;
+    cached->minx = info.minx;
+    cached->maxx = info.maxx;
+    cached->miny = info.miny;
+    cached->maxy = info.maxy;
+    cached->yoffset = info.yoffset;
+    cached->advance = info.advance;
+    cached->stored |= CACHED_METRICS | CACHED_PIXMAP;
+    cached->cached = ch;
+    return 1;
+}
+
+static void Store_CachedGlyph( TTF_Font* font, Uint16 ch, c_glyph* cached )
+{
+    TTF_CachedGlyphKey key;
+    TTF_CachedGlyphInfo info;
+
+    Fill_CachedGlyphKey( font, ch, &key );
+    info.index = cached->index;
+    info.minx = cached->minx;
+    info.maxx = cached->maxx;
+    info.miny = cached->miny;
+    info.maxy = cached->maxy;
+    info.yoffset = cached->yoffset;
+    info.advance = cached->advance;
+    info.width = cached->pixmap.width;
+    info.rows = cached->pixmap.rows;
+    info.pitch = cached->pixmap.pitch;
+    TTF_CppWrap_StoreCachedGlyph( &key, &info, cached->pixmap.buffer );
+}
+
+static FT_Error Load_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want )
+{
+    FT_Error error;
+    int had_pixmap = cached->stored & CACHED_PIXMAP;
+    /* The persistent cache only holds the metrics and pixmap of glyphs of fonts opened from memory */
+    int use_glyph_cache = font && font->src_mem && !(want & CACHED_BITMAP) && !had_pixmap;
+
+    if ( use_glyph_cache && Load_CachedGlyph( font, ch, cached ) ) {
+        return 0;
+    }
+
+    TTF_lockLibrary();
+    error = Render_Glyph( font, ch, cached, want );
+    TTF_unlockLibrary();
+
+    if ( !error && use_glyph_cache && (cached->stored & CACHED_PIXMAP) && (cached->stored & CACHED_METRICS) ) {
+        Store_CachedGlyph( font, ch, cached );
+    }
+    return error;
+}
+
 static FT_Error Find_Glyph( TTF_Font* font, Uint16 ch, int want )
 {
     int retval = 0;
@@ -920,13 +1277,53 @@ static FT_Error Find_Glyph( TTF_Font* font, Uint16 ch, int want )
     return retval;
 }
 
+static c_metrics *Find_Metrics( TTF_Font* font, Uint16 ch, FT_Error *error )
+{
+    int hsize = sizeof( font->metrics_cache ) / sizeof( font->metrics_cache[0] );
+    c_metrics *metrics = &font->metrics_cache[ch % hsize];
+
+    if ( !metrics->stored || (metrics->cached != ch) ) {
+        int cache_hsize = sizeof( font->cache ) / sizeof( font->cache[0] );
+        c_glyph *glyph = &font->cache[ch % cache_hsize];
+        c_glyph scratch;
+
+        /* Loaded on the side otherwise, so that the glyph sharing the slot in the glyph cache stays there */
+        if ( (glyph->cached != ch) || !(glyph->stored & CACHED_METRICS) ) {
+            memset( &scratch, 0, sizeof( scratch ) );
+            TTF_lockLibrary();
+            *error = Render_Glyph( font, ch, &scratch, CACHED_METRICS );
+            TTF_unlockLibrary();
+            if ( *error ) {
+                return NULL;
+            }
+            glyph = &scratch;
+        }
+
+        metrics->index = glyph->index;
+        metrics->minx = glyph->minx;
+        metrics->maxx = glyph->maxx;
+        metrics->miny = glyph->miny;
+        metrics->maxy = glyph->maxy;
+        metrics->advance = glyph->advance;
+        metrics->cached = ch;
+        metrics->stored = 1;
+    }
+    return metrics;
+}
+
 void TTF_CloseFont( TTF_Font* font )
 {
     if ( font ) {
         Flush_Cache( font );
+        free( font->kerning_cache );
+        TTF_lockLibrary();
+        if ( font->size ) {
+            FT_Done_Size( font->size );
+        }
         if ( font->face ) {
             FT_Done_Face( font->face );
         }
+        TTF_unlockLibrary();
         if ( font->args.stream ) {
             free( font->args.stream );
         }
@@ -1136,7 +1533,11 @@ char *TTF_FontFaceStyleName(const TTF_Font *font)
 
 int TTF_GlyphIsProvided(const TTF_Font *font, Uint16 ch)
 {
-  return(FT_Get_Char_Index(font->face, ch));
+  int provided;
+  TTF_lockLibrary();
+  provided = FT_Get_Char_Index(font->face, ch);
+  TTF_unlockLibrary();
+  return(provided);
 }
 
 int TTF_GlyphMetrics(TTF_Font *font, Uint16 ch,
@@ -1192,18 +1593,24 @@ int TTF_SizeText(TTF_Font *font, const char *text, int *w, int *h)
     return status;
 }
 
-int TTF_SizeUTF8(TTF_Font *ttf_font, const char *text, int *w, int *h)
+int TTF_SizeUTF8(TTF_Font *font, const char *text, int *w, int *h)
+{
+    TTF_CHECKPOINTER(text, -1);
+
+    return TTF_SizeUTF8_Len(font, text, SDL_strlen(text), w, h);
+}
+
+int TTF_SizeUTF8_Len(TTF_Font *ttf_font, const char *text, size_t textlen, int *w, int *h)
 {
     int status;
     int x, z;
     int minx, maxx;
     int miny, maxy;
-    c_glyph *glyph;
+    c_metrics *glyph;
     FT_Error error;
     FT_Long use_kerning;
     FT_UInt prev_index = 0;
     int outline_delta = 0;
-    size_t textlen;
 
     TTF_CHECKPOINTER(text, -1);
 
@@ -1216,7 +1623,6 @@ int TTF_SizeUTF8(TTF_Font *ttf_font, const char *text, int *w, int *h)
     TTF_Font *font = orig_font;
 
     /* Load each character and sum it's bounding box */
-    textlen = SDL_strlen(text);
     x= 0;
     while ( textlen > 0 ) {
         Uint16 c = UTF8_getch(&text, &textlen);
@@ -1236,38 +1642,16 @@ int TTF_SizeUTF8(TTF_Font *ttf_font, const char *text, int *w, int *h)
             continue;
         }
 
-        error = Find_Glyph(font, c, CACHED_METRICS);
-        if ( error ) {
+        glyph = Find_Metrics(font, c, &error);
+        if ( !glyph ) {
             TTF_SetFTError("Couldn't find glyph", error);
             return -1;
         }
-        glyph = font->current;
 
         /* handle kerning */
         if ( use_kerning && prev_index && glyph->index ) {
-            FT_Vector delta;
-            FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta );
-            x += delta.x >> 6;
-        }
-
-#if 0
-        if ( (ch == text) && (glyph->minx < 0) ) {
-        /* Fixes the texture wrapping bug when the first letter
-         * has a negative minx value or horibearing value.  The entire
-         * bounding box must be adjusted to be bigger so the entire
-         * letter can fit without any texture corruption or wrapping.
-         *
-         * Effects: First enlarges bounding box.
-         * Second, xstart has to start ahead of its normal spot in the
-         * negative direction of the negative minx value.
-         * (pushes everything to the right).
-         *
-         * This will make the memory copy of the glyph bitmap data
-         * work out correctly.
-         * */
-            z -= glyph->minx;
+            x += TTF_getKerning( font, prev_index, glyph->index );
         }
-#endif
 
         z = x + glyph->minx;
         if ( minx > z ) {
@@ -1367,7 +1751,7 @@ SDL_Surface *TTF_RenderUTF8_Solid(TTF_Font *ttf_font,
     Uint8* src;
     Uint8* dst;
     Uint8 *dst_check;
-    int row, col;
+    int row;
     c_glyph *glyph;
 
     FT_Bitmap *current;
@@ -1438,9 +1822,7 @@ SDL_Surface *TTF_RenderUTF8_Solid(TTF_Font *ttf_font,
         }
         /* do kerning, if possible AC-Patch */
         if ( use_kerning && prev_index && glyph->index ) {
-            FT_Vector delta;
-            FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta );
-            xstart += delta.x >> 6;
+            xstart += TTF_getKerning( font, prev_index, glyph->index );
         }
         /* Compensate for wrap around bug with negative minx's */
         if ( first && (glyph->minx < 0) ) {
@@ -1462,9 +1844,7 @@ SDL_Surface *TTF_RenderUTF8_Solid(TTF_Font *ttf_font,
                 xstart + glyph->minx;
             src = current->buffer + row * current->pitch;
 
-            for ( col=width; col>0 && dst < dst_check; --col ) {
-                *dst++ |= *src++;
-            }
+            TTF_compositeRow_8(dst, src, TTF_CLAMP_ROW(dst, dst_check, width));
         }
 
         xstart += glyph->advance;
@@ -1553,7 +1933,7 @@ SDL_Surface *TTF_RenderUTF8_Shaded(TTF_Font *ttf_font,
     Uint8* src;
     Uint8* dst;
     Uint8* dst_check;
-    int row, col;
+    int row;
     FT_Bitmap* current;
     c_glyph *glyph;
     FT_Error error;
@@ -1626,9 +2006,7 @@ SDL_Surface *TTF_RenderUTF8_Shaded(TTF_Font *ttf_font,
         }
         /* do kerning, if possible AC-Patch */
         if ( use_kerning && prev_index && glyph->index ) {
-            FT_Vector delta;
-            FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta );
-            xstart += delta.x >> 6;
+            xstart += TTF_getKerning( font, prev_index, glyph->index );
         }
         /* Compensate for the wrap around with negative minx's */
         if ( first && (glyph->minx < 0) ) {
@@ -1650,9 +2028,7 @@ SDL_Surface *TTF_RenderUTF8_Shaded(TTF_Font *ttf_font,
                 (row+glyph->yoffset) * textbuf->pitch +
                 xstart + glyph->minx;
             src = current->buffer + row * current->pitch;
-            for ( col=width; col>0 && dst < dst_check; --col ) {
-                *dst++ |= *src++;
-            }
+            TTF_compositeRow_8(dst, src, TTF_CLAMP_ROW(dst, dst_check, width));
         }
 
         xstart += glyph->advance;
@@ -1735,12 +2111,11 @@ SDL_Surface *TTF_RenderUTF8_Blended(TTF_Font *ttf_font,
     int xstart;
     int width, height;
     SDL_Surface *textbuf;
-    Uint32 alpha;
     Uint32 pixel;
     Uint8 *src;
     Uint32 *dst;
     Uint32 *dst_check;
-    int row, col;
+    int row;
     c_glyph *glyph;
     FT_Error error;
     FT_Long use_kerning;
@@ -1801,9 +2176,7 @@ SDL_Surface *TTF_RenderUTF8_Blended(TTF_Font *ttf_font,
         }
         /* do kerning, if possible AC-Patch */
         if ( use_kerning && prev_index && glyph->index ) {
-            FT_Vector delta;
-            FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta );
-            xstart += delta.x >> 6;
+            xstart += TTF_getKerning( font, prev_index, glyph->index );
         }
 
         /* Compensate for the wrap around bug with negative minx's */
@@ -1829,10 +2202,7 @@ SDL_Surface *TTF_RenderUTF8_Blended(TTF_Font *ttf_font,
              * account for pitch.
              * */
             src = (Uint8*) (glyph->pixmap.buffer + glyph->pixmap.pitch * row);
-            for ( col = width; col>0 && dst < dst_check; --col) {
-                alpha = *src++;
-                *dst++ |= pixel | (alpha << 24);
-            }
+            TTF_compositeRow_ARGB(dst, src, TTF_CLAMP_ROW(dst, dst_check, width), pixel);
         }
 
         xstart += glyph->advance;
@@ -1905,6 +2275,217 @@ static SDL_bool CharacterIsDelimiter(char c, const char *delimiters)
     return SDL_FALSE;
 }
 
+/* Running horizontal extent of a line, accumulated exactly like TTF_SizeUTF8 does */
+typedef struct {
+    int x;
+    int minx;
+    int maxx;
+    FT_UInt prev_index;
+} c_extent;
+
+/* A wrapped line, pointing into the original text */
+typedef struct {
+    const char *text;
+    size_t len;
+} c_line;
+
+static int Extend_Line( TTF_Font *orig_font, c_extent *extent, Uint16 c )
+{
+    TTF_Font *font;
+    c_metrics *glyph;
+    FT_Error error;
+    int z;
+
+    if ( c == UNICODE_BOM_NATIVE || c == UNICODE_BOM_SWAPPED ) {
+        return 0;
+    }
+
+    font = TTF_CppWrap_FindValidFont(orig_font, c);
+    glyph = Find_Metrics(font, c, &error);
+    if ( !glyph ) {
+        TTF_SetFTError("Couldn't find glyph", error);
+        return -1;
+    }
+
+    /* handle kerning */
+    if ( FT_HAS_KERNING( font->face ) && font->kerning && extent->prev_index && glyph->index ) {
+        extent->x += TTF_getKerning( font, extent->prev_index, glyph->index );
+    }
+
+    z = extent->x + glyph->minx;
+    if ( extent->minx > z ) {
+        extent->minx = z;
+    }
+    if ( TTF_HANDLE_STYLE_BOLD(font) ) {
+        extent->x += font->glyph_overhang;
+    }
+    if ( glyph->advance > glyph->maxx ) {
+        z = extent->x + glyph->advance;
+    } else {
+        z = extent->x + glyph->maxx;
+    }
+    if ( extent->maxx < z ) {
+        extent->maxx = z;
+    }
+    extent->x += glyph->advance;
+    extent->prev_index = glyph->index;
+    return 0;
+}
+
+/* Splits the text into lines no wider than wrapLength in a single pass over it.
+ * Each line is broken after the last word which still fits; a word wider than
+ * the whole line is broken between characters instead. Every character is
+ * measured at most twice (only the word carried over to the next line is
+ * measured again), so this is linear in the length of the text. */
+static int Break_Lines( TTF_Font *font, const char *text, Uint32 wrapLength,
+                        c_line **out_lines, int *out_num_lines, int *out_max_width )
+{
+    const char *wrapDelims = " \t";
+    const char *end = text + SDL_strlen(text);
+    const char *tok = text;
+    int outline_delta = (font->outline > 0) ? (font->outline * 2) : 0;
+    c_line *lines = NULL;
+    int numLines = 0, capLines = 0;
+    int max_width = 0;
+
+    while ( tok < end ) {
+        const char *para_end = tok;
+        const char *next_para;
+        const char *line_start = tok;
+
+        /* Look for the end of the paragraph */
+        while ( para_end < end && *para_end != '\r' && *para_end != '\n' ) {
+            ++para_end;
+        }
+        next_para = para_end;
+        if ( next_para < end && *next_para == '\r' ) {
+            ++next_para;
+        }
+        if ( next_para < end && *next_para == '\n' ) {
+            ++next_para;
+        }
+
+        for ( ; ; ) {
+            c_extent extent = { 0, 0, 0, 0 };
+            const char *spot = line_start;
+            const char *content_end = line_start;
+            const char *break_end = NULL;
+            const char *line_end;
+            const char *next_line = para_end;
+            int content_width = 0;
+            int break_width = 0;
+            int line_width;
+
+            while ( spot < para_end ) {
+                const char *ch_start = spot;
+                size_t left = (size_t)(para_end - spot);
+                Uint16 c = (Uint16)UTF8_getch(&spot, &left);
+                int w;
+
+                if ( Extend_Line(font, &extent, c) < 0 ) {
+                    SDL_free(lines);
+                    return -1;
+                }
+
+                if ( CharacterIsDelimiter(*ch_start, wrapDelims) ) {
+                    /* Remember the end of the last word as a break candidate */
+                    if ( content_end == ch_start && content_end > line_start ) {
+                        break_end = content_end;
+                        break_width = content_width;
+                    }
+                    continue;
+                }
+
+                w = (extent.maxx - extent.minx) + outline_delta;
+                if ( (Uint32)w > wrapLength && content_end > line_start ) {
+                    if ( break_end ) {
+                        content_end = break_end;
+                        content_width = break_width;
+                        next_line = break_end;
+                    } else {
+                        next_line = ch_start;
+                    }
+                    break;
+                }
+                content_end = spot;
+                content_width = w;
+            }
+
+            /* Trailing whitespace is left out of the line */
+            line_end = content_end;
+            line_width = content_width;
+
+            if ( numLines == capLines ) {
+                c_line *new_lines;
+                capLines = capLines ? (capLines * 2) : 8;
+                new_lines = (c_line *)SDL_realloc(lines, capLines * sizeof(*lines));
+                if ( !new_lines ) {
+                    SDL_free(lines);
+                    TTF_SetError("Out of memory");
+                    return -1;
+                }
+                lines = new_lines;
+            }
+            lines[numLines].text = line_start;
+            lines[numLines].len = (size_t)(line_end - line_start);
+            ++numLines;
+            if ( line_width > max_width ) {
+                max_width = line_width;
+            }
+
+            /* Skip the delimiters the line was broken at */
+            while ( next_line < para_end && CharacterIsDelimiter(*next_line, wrapDelims) ) {
+                ++next_line;
+            }
+            if ( next_line >= para_end ) {
+                break;
+            }
+            line_start = next_line;
+        }
+
+        tok = next_para;
+    }
+
+    *out_lines = lines;
+    *out_num_lines = numLines;
+    *out_max_width = max_width;
+    return 0;
+}
+
+/* Space between wrapped lines, in pixels */
+#define WRAPPED_LINE_SPACE 2
+
+int TTF_SizeUTF8_Wrapped(TTF_Font *font, const char *text, Uint32 wrapLength, int *w, int *h)
+{
+    int width, height;
+    int numLines = 1;
+    int max_width = 0;
+    c_line *lines = NULL;
+
+    TTF_CHECKPOINTER(text, -1);
+
+    if ( TTF_SizeUTF8(font, text, &width, &height) < 0 ) {
+        return -1;
+    }
+    /* Nothing gets rendered for these */
+    if ( !width ) {
+        if ( w ) *w = 0;
+        if ( h ) *h = 0;
+        return 0;
+    }
+
+    if ( wrapLength > 0 && *text ) {
+        if ( Break_Lines(font, text, wrapLength, &lines, &numLines, &max_width) < 0 ) {
+            return -1;
+        }
+        SDL_free(lines);
+    }
+
+    if ( w ) *w = (numLines > 1) ? max_width : width;
+    if ( h ) *h = height * numLines + (WRAPPED_LINE_SPACE * (numLines - 1));
+    return 0;
+}
+
 SDL_Surface *TTF_RenderUTF8_Blended_Wrapped(TTF_Font *ttf_font,
                                     const char *text, SDL_Color fg, Uint32 wrapLength)
 {
@@ -1912,19 +2493,18 @@ SDL_Surface *TTF_RenderUTF8_Blended_Wrapped(TTF_Font *ttf_font,
     int xstart;
     int width, height;
     SDL_Surface *textbuf;
-    Uint32 alpha;
     Uint32 pixel;
     Uint8 *src;
     Uint32 *dst;
     Uint32 *dst_check;
-    int row, col;
+    int row;
     c_glyph *glyph;
     FT_Error error;
     FT_Long use_kerning;
     FT_UInt prev_index = 0;
-    const int lineSpace = 2;
+    const int lineSpace = WRAPPED_LINE_SPACE;
     int line, numLines, rowSize;
-    char *str, **strLines;
+    c_line *lines;
     size_t textlen;
     int max_width;
 
@@ -1938,84 +2518,11 @@ SDL_Surface *TTF_RenderUTF8_Blended_Wrapped(TTF_Font *ttf_font,
 
     max_width = 0;
     numLines = 1;
-    str = NULL;
-    strLines = NULL;
+    lines = NULL;
     if ( wrapLength > 0 && *text ) {
-        const char *wrapDelims = " \t\r\n";
-        int w, h;
-        char *spot, *tok, *next_tok, *end;
-        char delim;
-        size_t str_len = SDL_strlen(text);
-
-        numLines = 0;
-
-        str = SDL_stack_alloc(char, str_len+1);
-        if ( str == NULL ) {
-            TTF_SetError("Out of memory");
+        if ( Break_Lines(ttf_font, text, wrapLength, &lines, &numLines, &max_width) < 0 ) {
             return(NULL);
         }
-
-        SDL_strlcpy(str, text, str_len+1);
-        tok = str;
-        end = str + str_len;
-        do {
-            strLines = (char **)SDL_realloc(strLines, (numLines+1)*sizeof(*strLines));
-            if (!strLines) {
-                TTF_SetError("Out of memory");
-                return(NULL);
-            }
-            strLines[numLines++] = tok;
-
-            /* Look for the end of the line */
-            if ((spot = SDL_strchr(tok, '\r')) != NULL ||
-                (spot = SDL_strchr(tok, '\n')) != NULL) {
-                if (*spot == '\r') {
-                    ++spot;
-                }
-                if (*spot == '\n') {
-                    ++spot;
-                }
-            } else {
-                spot = end;
-            }
-            next_tok = spot;
-
-            /* Get the longest string that will fit in the desired space */
-            for ( ; ; ) {
-                /* Strip trailing whitespace */
-                while ( spot > tok &&
-                        CharacterIsDelimiter(spot[-1], wrapDelims) ) {
-                    --spot;
-                }
-                if ( spot == tok ) {
-                    if (CharacterIsDelimiter(*spot, wrapDelims)) {
-                        *spot = '\0';
-                    }
-                    break;
-                }
-                delim = *spot;
-                *spot = '\0';
-
-                TTF_SizeUTF8(ttf_font, tok, &w, &h);
-                if ((Uint32)w <= wrapLength) {
-                    if (w > max_width)
-                        max_width = w;
-                    break;
-                } else {
-                    /* Back up and try again... */
-                    *spot = delim;
-                }
-
-                while ( spot > tok &&
-                        !CharacterIsDelimiter(spot[-1], wrapDelims) ) {
-                    --spot;
-                }
-                if ( spot > tok ) {
-                    next_tok = spot;
-                }
-            }
-            tok = next_tok;
-        } while (tok < end);
     }
 
     /* Create the target surface */
@@ -2024,10 +2531,7 @@ SDL_Surface *TTF_RenderUTF8_Blended_Wrapped(TTF_Font *ttf_font,
             height * numLines + (lineSpace * (numLines - 1)),
             32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
     if ( textbuf == NULL ) {
-        if ( strLines ) {
-            SDL_free(strLines);
-            SDL_stack_free(str);
-        }
+        SDL_free(lines);
         return(NULL);
     }
 
@@ -2045,12 +2549,15 @@ SDL_Surface *TTF_RenderUTF8_Blended_Wrapped(TTF_Font *ttf_font,
     SDL_FillRect(textbuf, NULL, pixel); /* Initialize with fg and 0 alpha */
 
     for ( line = 0; line < numLines; line++ ) {
-        if ( strLines ) {
-            text = strLines[line];
+        if ( lines ) {
+            text = lines[line].text;
+            textlen = lines[line].len;
+        } else {
+            textlen = SDL_strlen(text);
         }
-        textlen = SDL_strlen(text);
         first = SDL_TRUE;
         xstart = 0;
+        prev_index = 0;
         while ( textlen > 0 ) {
             Uint16 c = UTF8_getch(&text, &textlen);
             if ( c == UNICODE_BOM_NATIVE || c == UNICODE_BOM_SWAPPED ) {
@@ -2065,6 +2572,7 @@ SDL_Surface *TTF_RenderUTF8_Blended_Wrapped(TTF_Font *ttf_font,
             error = Find_Glyph(font, c, CACHED_METRICS|CACHED_PIXMAP);
             if ( error ) {
                 TTF_SetFTError("Couldn't find glyph", error);
+                SDL_free(lines);
                 SDL_FreeSurface( textbuf );
                 return NULL;
             }
@@ -2077,9 +2585,7 @@ SDL_Surface *TTF_RenderUTF8_Blended_Wrapped(TTF_Font *ttf_font,
             }
             /* do kerning, if possible AC-Patch */
             if ( use_kerning && prev_index && glyph->index ) {
-                FT_Vector delta;
-                FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta );
-                xstart += delta.x >> 6;
+                xstart += TTF_getKerning( font, prev_index, glyph->index );
             }
 
             /* Compensate for the wrap around bug with negative minx's */
@@ -2105,10 +2611,7 @@ SDL_Surface *TTF_RenderUTF8_Blended_Wrapped(TTF_Font *ttf_font,
                  * account for pitch.
                  * */
                 src = (Uint8*) (glyph->pixmap.buffer + glyph->pixmap.pitch * row);
-                for ( col = width; col>0 && dst < dst_check; --col) {
-                    alpha = *src++;
-                    *dst++ |= pixel | (alpha << 24);
-                }
+                TTF_compositeRow_ARGB(dst, src, TTF_CLAMP_ROW(dst, dst_check, width), pixel);
             }
 
             xstart += glyph->advance;
@@ -2133,10 +2636,7 @@ SDL_Surface *TTF_RenderUTF8_Blended_Wrapped(TTF_Font *ttf_font,
         */
     }
 
-    if ( strLines ) {
-        SDL_free(strLines);
-        SDL_stack_free(str);
-    }
+    SDL_free(lines);
     return(textbuf);
 }
 
@@ -2227,6 +2727,10 @@ void TTF_Quit( void )
     if ( TTF_initialized ) {
         if ( --TTF_initialized == 0 ) {
             FT_Done_FreeType( library );
+            if ( library_lock ) {
+                SDL_DestroyMutex( library_lock );
+                library_lock = NULL;
+            }
         }
     }
 }
@@ -2236,11 +2740,19 @@ int TTF_WasInit( void )
     return TTF_initialized;
 }
 
+int TTF_CacheGlyph(TTF_Font* font, Uint16 ch)
+{
+    FT_Error error = Find_Glyph(font, ch, CACHED_METRICS|CACHED_PIXMAP);
+    if ( error ) {
+        TTF_SetFTError("Couldn't find glyph", error);
+        return -1;
+    }
+    return 0;
+}
+
 int TTF_GetFontKerningSize(TTF_Font* font, int prev_index, int index)
 {
-    FT_Vector delta;
-    FT_Get_Kerning( font->face, prev_index, index, ft_kerning_default, &delta );
-    return (delta.x >> 6);
+    return TTF_getKerning( font, prev_index, index );
 }
 
 void *TTF_CppWrap_GetCppPtrRef(TTF_Font *font)
@@ -0,0 +1,101 @@
+/*
+  Plutonium's SDL_ttf fork: glyph compositing row kernels
+
+  Included by sdl2_CustomTtf.c (and the host tests), which must have SDL's
+  Uint8 and Uint32 types defined beforehand.
+*/
+
+#ifndef SDL2_CUSTOM_TTF_COMPOSITE_H_
+#define SDL2_CUSTOM_TTF_COMPOSITE_H_
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TTF_USE_NEON
+#include <arm_neon.h>
+#elif defined(__AVX2__)
+#define TTF_USE_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#define TTF_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+/* Glyph compositing row kernels.
+   Every renderer merges a glyph into the surface one row at a time; the
+   number of pixels is clamped against the end of the surface once per row
+   by the caller, so the kernels themselves need no bounds checks. Both
+   produce exactly the same output as the plain per-pixel loops below them.
+*/
+
+/* dst[i] |= src[i], for 8-bit palettized surfaces (solid and shaded) */
+static void TTF_compositeRow_8(Uint8 *dst, const Uint8 *src, int count)
+{
+    int i = 0;
+#if defined(TTF_USE_NEON)
+    for ( ; i + 16 <= count; i += 16 ) {
+        vst1q_u8(dst + i, vorrq_u8(vld1q_u8(dst + i), vld1q_u8(src + i)));
+    }
+#elif defined(TTF_USE_AVX2)
+    for ( ; i + 32 <= count; i += 32 ) {
+        const __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        const __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(d, s));
+    }
+#elif defined(TTF_USE_SSE2)
+    for ( ; i + 16 <= count; i += 16 ) {
+        const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(d, s));
+    }
+#endif
+    for ( ; i < count; ++i ) {
+        dst[i] |= src[i];
+    }
+}
+
+/* dst[i] |= pixel | (src[i] << 24), merging 8-bit coverage into the alpha
+   channel of ARGB8888 surfaces (blended) */
+static void TTF_compositeRow_ARGB(Uint32 *dst, const Uint8 *src, int count, Uint32 pixel)
+{
+    int i = 0;
+#if defined(TTF_USE_NEON)
+    /* Deinterleaved load: val[0..3] hold the B, G, R and A bytes of 16 pixels */
+    const uint8x16_t b = vdupq_n_u8((Uint8)pixel);
+    const uint8x16_t g = vdupq_n_u8((Uint8)(pixel >> 8));
+    const uint8x16_t r = vdupq_n_u8((Uint8)(pixel >> 16));
+    const uint8x16_t a = vdupq_n_u8((Uint8)(pixel >> 24));
+    for ( ; i + 16 <= count; i += 16 ) {
+        uint8x16x4_t px = vld4q_u8((const uint8_t *)(dst + i));
+        px.val[0] = vorrq_u8(px.val[0], b);
+        px.val[1] = vorrq_u8(px.val[1], g);
+        px.val[2] = vorrq_u8(px.val[2], r);
+        px.val[3] = vorrq_u8(px.val[3], vorrq_u8(a, vld1q_u8(src + i)));
+        vst4q_u8((uint8_t *)(dst + i), px);
+    }
+#elif defined(TTF_USE_AVX2)
+    const __m256i px = _mm256_set1_epi32((int)pixel);
+    for ( ; i + 8 <= count; i += 8 ) {
+        const __m256i cov = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(src + i)));
+        const __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(d, _mm256_or_si256(px, _mm256_slli_epi32(cov, 24))));
+    }
+#elif defined(TTF_USE_SSE2)
+    const __m128i px = _mm_set1_epi32((int)pixel);
+    const __m128i zero = _mm_setzero_si128();
+    for ( ; i + 16 <= count; i += 16 ) {
+        /* Interleaving zeroes below each coverage byte twice leaves it in the top byte of a 32-bit lane */
+        const __m128i cov = _mm_loadu_si128((const __m128i *)(src + i));
+        const __m128i cov_lo = _mm_unpacklo_epi8(zero, cov);
+        const __m128i cov_hi = _mm_unpackhi_epi8(zero, cov);
+        __m128i *d = (__m128i *)(dst + i);
+        _mm_storeu_si128(d + 0, _mm_or_si128(_mm_loadu_si128(d + 0), _mm_or_si128(px, _mm_unpacklo_epi16(zero, cov_lo))));
+        _mm_storeu_si128(d + 1, _mm_or_si128(_mm_loadu_si128(d + 1), _mm_or_si128(px, _mm_unpackhi_epi16(zero, cov_lo))));
+        _mm_storeu_si128(d + 2, _mm_or_si128(_mm_loadu_si128(d + 2), _mm_or_si128(px, _mm_unpacklo_epi16(zero, cov_hi))));
+        _mm_storeu_si128(d + 3, _mm_or_si128(_mm_loadu_si128(d + 3), _mm_or_si128(px, _mm_unpackhi_epi16(zero, cov_hi))));
+    }
+#endif
+    for ( ; i < count; ++i ) {
+        dst[i] |= pixel | ((Uint32)src[i] << 24);
+    }
+}
+
+#endif /* SDL2_CUSTOM_TTF_COMPOSITE_H_ */
@@ -3,8 +3,43 @@
 
 namespace pu::sdl2 {
 
+    namespace {
+
+        TextureHandle::Level MakeLevel(Texture tex) {
+            i32 w = 0;
+            i32 h = 0;
+            if(tex != nullptr) {
+                SDL_QueryTexture(tex, nullptr, nullptr, &w, &h);
+            }
+            return { tex, w, h };
+        }
+
+    }
+
+    TextureHandle::TextureHandle(Texture tex) : base(MakeLevel(tex)), mipmaps() {}
+
     TextureHandle::~TextureHandle() {
-        ui::render::DeleteTexture(this->tex);
+        ui::render::DeleteTexture(this->base.tex);
+        for(auto &level : this->mipmaps) {
+            ui::render::DeleteTexture(level.tex);
+        }
+    }
+
+    void TextureHandle::AddMipmap(Texture tex) {
+        if(tex != nullptr) {
+            this->mipmaps.push_back(MakeLevel(tex));
+        }
+    }
+
+    Texture TextureHandle::GetFor(const i32 width, const i32 height) {
+        auto tex = this->base.tex;
+        for(const auto &level : this->mipmaps) {
+            if((level.width < width) || (level.height < height)) {
+                break;
+            }
+            tex = level.tex;
+        }
+        return tex;
     }
 
 }
@@ -6,15 +6,60 @@ namespace pu::ttf {
 
     namespace {
 
+        // Font files are read once and shared by every font (of any size) loading them, until the last one unloads them
+
+        struct FontFileBuffer {
+            u8 *buf;
+            size_t buf_size;
+            u32 ref_count;
+        };
+
+        // Fonts may be loaded and released (like when the last reference drops) on any thread
+        Mutex g_FontFileBufferLock = {};
+        std::unordered_map<std::string, FontFileBuffer> g_FontFileBufferTable;
+
         void FileBufferFontFaceDisposingFunction(void *ptr) {
             if(ptr != nullptr) {
-                auto file_buf = reinterpret_cast<u8*>(ptr);
-                delete[] file_buf;
+                mutexLock(&g_FontFileBufferLock);
+                for(auto it = g_FontFileBufferTable.begin(); it != g_FontFileBufferTable.end(); it++) {
+                    auto &file_buf = it->second;
+                    if(file_buf.buf == ptr) {
+                        file_buf.ref_count--;
+                        if(file_buf.ref_count == 0) {
+                            delete[] file_buf.buf;
+                            g_FontFileBufferTable.erase(it);
+                        }
+                        break;
+                    }
+                }
+                mutexUnlock(&g_FontFileBufferLock);
+            }
+        }
+
+        // Takes a reference to the file's buffer if it's loaded already
+        bool AcquireLoadedFontFile(const std::string &path, FontFileBuffer &out_file_buf) {
+            auto it = g_FontFileBufferTable.find(path);
+            if(it == g_FontFileBufferTable.end()) {
+                return false;
             }
+
+            it->second.ref_count++;
+            out_file_buf = it->second;
+            return true;
         }
 
     }
 
+    size_t GetLoadedFontFilesSize() {
+        size_t total_size = 0;
+        mutexLock(&g_FontFileBufferLock);
+        for(const auto &[path, file_buf] : g_FontFileBufferTable) {
+            total_size += file_buf.buf_size;
+        }
+        mutexUnlock(&g_FontFileBufferLock);
+        return total_size;
+    }
+
     Font::~Font() {
         for(auto &[idx, font] : this->font_faces) {
             font->Dispose();
@@ -23,99 +68,221 @@ namespace pu::ttf {
 
     i32 Font::LoadFromMemory(void *ptr, const size_t size, FontFaceDisposingFunction disp_fn) {
         const auto idx = rand();
-        auto font = std::make_unique<FontFace>(ptr, size, disp_fn, this->font_size, reinterpret_cast<void*>(this));
+        auto font = std::make_unique<FontFace>(ptr, size, disp_fn);
+        rmutexLock(&this->lock);
         this->font_faces.push_back({ idx, std::move(font) });
+        this->ResetCaches();
+        rmutexUnlock(&this->lock);
         return idx;
     }
 
     i32 Font::LoadFromFile(const std::string &path) {
+        FontFileBuffer file_buf = {};
+        mutexLock(&g_FontFileBufferLock);
+        const auto loaded = AcquireLoadedFontFile(path, file_buf);
+        mutexUnlock(&g_FontFileBufferLock);
+        if(loaded) {
+            return this->LoadFromMemory(file_buf.buf, file_buf.buf_size, FileBufferFontFaceDisposingFunction);
+        }
+
+        // Read without holding the lock, so that other fonts aren't held back by file I/O
         auto f = fopen(path.c_str(), "rb");
-        if(f) {
-            fseek(f, 0, SEEK_END);
-            const auto f_size = ftell(f);
-            rewind(f);
-            if(f_size > 0) {
-                auto font_buf = new u8[f_size]();
-                fread(font_buf, 1, f_size, f);
-                fclose(f);
-                return this->LoadFromMemory(font_buf, f_size, FileBufferFontFaceDisposingFunction);
-            }
+        if(f == nullptr) {
+            return InvalidFontFaceIndex;
+        }
+        fseek(f, 0, SEEK_END);
+        const auto f_size = ftell(f);
+        rewind(f);
+        if(f_size <= 0) {
             fclose(f);
+            return InvalidFontFaceIndex;
         }
+        auto font_buf = new u8[f_size]();
+        fread(font_buf, 1, f_size, f);
+        fclose(f);
 
-        return InvalidFontFaceIndex;
+        // Another thread may have loaded the same file meanwhile, in which case its buffer is used instead
+        mutexLock(&g_FontFileBufferLock);
+        if(AcquireLoadedFontFile(path, file_buf)) {
+            delete[] font_buf;
+        }
+        else {
+            file_buf = { font_buf, static_cast<size_t>(f_size), 1 };
+            g_FontFileBufferTable[path] = file_buf;
+        }
+        mutexUnlock(&g_FontFileBufferLock);
+        return this->LoadFromMemory(file_buf.buf, file_buf.buf_size, FileBufferFontFaceDisposingFunction);
     }
 
     void Font::Unload(const i32 font_idx) {
+        rmutexLock(&this->lock);
         u32 i = 0;
         for(auto &[idx, font]: this->font_faces) {
             if(idx == font_idx) {
+                font->Dispose();
                 this->font_faces.erase(this->font_faces.begin() + i);
+                this->ResetCaches();
                 break;
             }
             i++;
         }
+        rmutexUnlock(&this->lock);
+    }
+
+    bool Font::GetPrimaryFaceSource(void *&out_ptr, size_t &out_size) {
+        rmutexLock(&this->lock);
+        for(const auto &[idx, face] : this->font_faces) {
+            if(face->IsSourceValid()) {
+                out_ptr = face->ptr;
+                out_size = face->ptr_sz;
+                rmutexUnlock(&this->lock);
+                return true;
+            }
+        }
+        rmutexUnlock(&this->lock);
+        return false;
+    }
+
+    void Font::ResetCaches() {
+        for(auto &page: this->coverage_pages) {
+            page.reset();
+        }
+        for(auto &entry: this->text_dims_cache) {
+            entry.valid = false;
+        }
     }
 
     sdl2::Font Font::FindValidFontFor(const Uint16 ch) {
-        for(const auto &[idx, font] : this->font_faces) {
-            if(TTF_GlyphIsProvided(font->font, ch)) {
-                return font->font;
+        // Also called back while rasterizing, where the lock is already held by this same thread
+        rmutexLock(&this->lock);
+        auto &page = this->coverage_pages[ch / CoveragePageSize];
+        if(page == nullptr) {
+            page = std::make_unique<CoveragePage>();
+            page->fill(CoverageUnresolved);
+        }
+
+        auto &entry = (*page)[ch % CoveragePageSize];
+        if(entry == CoverageUnresolved) {
+            // Only walk the faces the first time this codepoint is looked up, the result is kept for later lookups
+            // Faces already open are tried first, remaining fallbacks are only opened (in order) when none of them has it
+            entry = CoverageNotProvided;
+            const auto face_count = std::min(this->font_faces.size(), static_cast<size_t>(CoverageNotProvided - 1));
+            for(u32 i = 0; i < face_count; i++) {
+                auto &face = this->font_faces.at(i).second;
+                if((face->font != nullptr) && TTF_GlyphIsProvided(face->font, ch)) {
+                    entry = static_cast<u8>(i + 1);
+                    break;
+                }
+            }
+            if(entry == CoverageNotProvided) {
+                for(u32 i = 0; i < face_count; i++) {
+                    auto &face = this->font_faces.at(i).second;
+                    if(!face->open_tried) {
+                        auto font = face->Open(this->font_size, reinterpret_cast<void*>(this));
+                        if((font != nullptr) && TTF_GlyphIsProvided(font, ch)) {
+                            entry = static_cast<u8>(i + 1);
+                            break;
+                        }
+                    }
+                }
             }
         }
 
-        return nullptr;
+        sdl2::Font font = nullptr;
+        if(entry != CoverageNotProvided) {
+            font = this->font_faces.at(entry - 1).second->font;
+        }
+        rmutexUnlock(&this->lock);
+        return font;
     }
 
     namespace {
 
-        inline void ProcessLineDimensionsImpl(sdl2::Font font, std::string &str, u32 &w, u32 &h) {
-            i32 str_w = 0;
-            i32 str_h = 0;
-            TTF_SizeUTF8(font, str.c_str(), &str_w, &str_h);
+        inline void ProcessLineDimensionsImpl(sdl2::Font font, const std::string_view &line, u32 &w, u32 &h) {
+            i32 line_w = 0;
+            i32 line_h = 0;
+            TTF_SizeUTF8_Len(font, line.data(), line.length(), &line_w, &line_h);
 
-            const auto str_w_32 = static_cast<u32>(str_w);
-            const auto str_h_32 = static_cast<u32>(str_h);
-            if(str_w_32 > w) {
-                w = str_w_32;
+            const auto line_w_32 = static_cast<u32>(line_w);
+            const auto line_h_32 = static_cast<u32>(line_h);
+            if(line_w_32 > w) {
+                w = line_w_32;
             }
-            h += str_h_32;
-            str = "";
+            h += line_h_32;
         }
 
     }
 
-    std::pair<u32, u32> Font::GetTextDimensions(const std::string &str) {
+    std::pair<u32, u32> Font::GetTextDimensions(const std::string_view &str) {
+        rmutexLock(&this->lock);
+        auto &cache_entry = this->text_dims_cache[std::hash<std::string_view>{}(str) % TextDimensionsCacheSize];
+        if(!cache_entry.valid || (cache_entry.str != str)) {
+            cache_entry.valid = true;
+            cache_entry.str.assign(str);
+            cache_entry.dims = this->ComputeTextDimensions(str);
+        }
+        const auto dims = cache_entry.dims;
+        rmutexUnlock(&this->lock);
+        return dims;
+    }
+
+    std::pair<u32, u32> Font::ComputeTextDimensions(const std::string_view &str) {
+        rmutexLock(&this->lock);
+        auto font = this->TryGetFirstFont();
+        if(font == nullptr) {
+            rmutexUnlock(&this->lock);
+            return { 0, 0 };
+        }
+
         u32 w = 0;
         u32 h = 0;
-        auto font = this->TryGetFirstFont();
-        if(font != nullptr) {
-            std::string tmp_line;
-            for(const auto &ch: str) {
-                if(ch == '\n') {
-                    ProcessLineDimensionsImpl(font, tmp_line, w, h);
-                }
-                else {
-                    tmp_line += ch;
+        size_t line_start = 0;
+        while(true) {
+            const auto line_end = str.find('\n', line_start);
+            if(line_end == std::string_view::npos) {
+                if(line_start < str.length()) {
+                    ProcessLineDimensionsImpl(font, str.substr(line_start), w, h);
                 }
+                break;
             }
-            if(!tmp_line.empty()) {
-                ProcessLineDimensionsImpl(font, tmp_line, w, h);
-            }
+
+            ProcessLineDimensionsImpl(font, str.substr(line_start, line_end - line_start), w, h);
+            line_start = line_end + 1;
         }
+        rmutexUnlock(&this->lock);
         return { w, h };
     }
 
-    sdl2::Texture Font::RenderText(const std::string &str, const ui::Color clr) {
+    std::pair<u32, u32> Font::GetWrappedTextDimensions(const std::string &str, const u32 wrap_width) {
+        const auto w = (wrap_width > 0) ? wrap_width : ui::render::GetDefaultWrapWidth();
+
+        rmutexLock(&this->lock);
+        i32 text_w = 0;
+        i32 text_h = 0;
         auto font = this->TryGetFirstFont();
-        if(font != nullptr) {
-            const auto [w, _] = ui::render::GetDimensions();
-            auto srf = TTF_RenderUTF8_Blended_Wrapped(font, str.c_str(), { clr.r, clr.g, clr.b, clr.a }, w);
-            return ui::render::ConvertToTexture(srf);
+        if((font == nullptr) || (TTF_SizeUTF8_Wrapped(font, str.c_str(), w, &text_w, &text_h) != 0)) {
+            text_w = 0;
+            text_h = 0;
         }
-        else {
-            return nullptr;
+        rmutexUnlock(&this->lock);
+        return { static_cast<u32>(text_w), static_cast<u32>(text_h) };
+    }
+
+    sdl2::Surface Font::RenderTextSurface(const std::string &str, const ui::Color clr, const u32 wrap_width) {
+        const auto w = (wrap_width > 0) ? wrap_width : ui::render::GetDefaultWrapWidth();
+
+        rmutexLock(&this->lock);
+        sdl2::Surface srf = nullptr;
+        auto font = this->TryGetFirstFont();
+        if(font != nullptr) {
+            srf = TTF_RenderUTF8_Blended_Wrapped(font, str.c_str(), { clr.r, clr.g, clr.b, clr.a }, w);
         }
+        rmutexUnlock(&this->lock);
+        return srf;
+    }
+
+    sdl2::Texture Font::RenderText(const std::string &str, const ui::Color clr, const u32 wrap_width) {
+        return ui::render::ConvertToTexture(this->RenderTextSurface(str, clr, wrap_width));
     }
 
 }
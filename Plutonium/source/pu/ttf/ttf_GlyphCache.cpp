@@ -0,0 +1,462 @@
+#include <pu/ttf/ttf_GlyphCache.hpp>
+#include <pu/jobs/jobs_JobSystem.hpp>
+#include <unordered_map>
+#include <unordered_set>
+#include <atomic>
+#include <cstring>
+
+namespace pu::ttf {
+
+    namespace {
+
+        constexpr u32 GlyphCacheMagic = 0x43475550; // "PUGC"
+        constexpr u32 GlyphCacheVersion = 3;
+
+        // Only this much of the start and the end of the font data is hashed, which is enough to tell fonts apart
+        constexpr size_t FontHashSampleSize = 0x10000;
+
+        // Keeps both the file and the memory used by the cache bounded, glyphs past these are just not cached
+        constexpr u32 MaxEntryCount = 0x4000;
+        constexpr size_t MaxTotalSize = 8 * 1024 * 1024;
+        // No glyph rendered at a sensible size gets anywhere near this
+        constexpr s64 MaxGlyphDimension = 0x400;
+
+        constexpr u64 HashSeed = 0xCBF29CE484222325;
+
+        struct GlyphCacheHeader {
+            u32 magic;
+            u32 version;
+            u32 entry_count;
+            u32 data_size;
+            // Of everything past the header, the whole file is discarded on any mismatch
+            u64 checksum;
+        };
+
+        struct GlyphCacheKey {
+            u64 font_hash;
+            u32 font_size;
+            u32 style;
+            u32 outline;
+            u32 hinting;
+            u32 codepoint;
+            u32 face_index;
+
+            inline bool operator==(const GlyphCacheKey &other) const {
+                return (this->font_hash == other.font_hash) && (this->face_index == other.face_index) && (this->font_size == other.font_size) && (this->style == other.style) && (this->outline == other.outline) && (this->hinting == other.hinting) && (this->codepoint == other.codepoint);
+            }
+        };
+
+        struct GlyphCacheKeyHash {
+            inline size_t operator()(const GlyphCacheKey &key) const {
+                return std::hash<u64>{}(key.font_hash ^ (static_cast<u64>(key.codepoint) << 32) ^ (static_cast<u64>(key.face_index) << 56) ^ (static_cast<u64>(key.font_size) << 16) ^ (key.style + (key.outline << 8) + key.hinting));
+            }
+        };
+
+        // Stored in the file right before each glyph's pixmap
+        struct GlyphCacheEntryHeader {
+            GlyphCacheKey key;
+            TTF_CachedGlyphInfo info;
+        };
+
+        struct GlyphCacheEntry {
+            TTF_CachedGlyphInfo info;
+            // Points either inside the loaded file buffer or to the glyph's own copy
+            const u8 *pixmap;
+            std::unique_ptr<u8[]> own_pixmap;
+        };
+
+        inline size_t GetPixmapSize(const TTF_CachedGlyphInfo &info) {
+            return static_cast<size_t>(info.pitch) * static_cast<size_t>(info.rows);
+        }
+
+        inline size_t GetEntrySize(const TTF_CachedGlyphInfo &info) {
+            return sizeof(GlyphCacheEntryHeader) + GetPixmapSize(info);
+        }
+
+        // Checked the same way before storing glyphs, so that a glyph saved to the file never invalidates it later
+        bool IsValidEntry(const GlyphCacheEntryHeader &entry_header) {
+            const auto &info = entry_header.info;
+            if((info.width < 0) || (info.rows < 0) || (info.pitch < info.width) || (info.pitch > MaxGlyphDimension) || (info.rows > MaxGlyphDimension)) {
+                return false;
+            }
+            if((info.minx > info.maxx) || (info.miny > info.maxy) || (info.advance < 0) || (info.advance > MaxGlyphDimension) || (entry_header.key.outline > MaxGlyphDimension)) {
+                return false;
+            }
+
+            // Outlines grow the bitmap past the glyph's box on both sides, and rounding may add another pixel
+            const auto slack = 2 * static_cast<s64>(entry_header.key.outline) + 1;
+            const auto box_width = static_cast<s64>(info.maxx) - static_cast<s64>(info.minx);
+            const auto box_height = static_cast<s64>(info.maxy) - static_cast<s64>(info.miny);
+            return (box_width <= MaxGlyphDimension) && (box_height <= MaxGlyphDimension) && (info.width <= (box_width + slack)) && (info.rows <= (box_height + slack));
+        }
+
+        std::atomic_bool g_Enabled = false;
+        RMutex g_Lock;
+        std::string g_Path;
+        std::unique_ptr<u8[]> g_FileBuffer;
+        std::unordered_map<GlyphCacheKey, GlyphCacheEntry, GlyphCacheKeyHash> g_EntryTable;
+        size_t g_TotalSize = 0;
+        // Only the prewarm charset's glyphs are kept if one was given, any glyph otherwise
+        std::unordered_set<u32> g_Codepoints;
+        bool g_Dirty = false;
+
+        std::vector<jobs::JobHandle> g_PrewarmJobs;
+        jobs::CancellationToken g_PrewarmToken;
+
+        inline void HashBytes(u64 &hash, const u8 *data, const size_t size) {
+            // FNV-1a
+            for(size_t i = 0; i < size; i++) {
+                hash ^= data[i];
+                hash *= 0x100000001B3;
+            }
+        }
+
+        inline GlyphCacheKey MakeKey(const TTF_CachedGlyphKey *key) {
+            return {
+                .font_hash = key->src_hash,
+                .font_size = static_cast<u32>(key->ptsize),
+                .style = static_cast<u32>(key->style),
+                .outline = static_cast<u32>(key->outline),
+                .hinting = static_cast<u32>(key->hinting),
+                .codepoint = key->ch,
+                .face_index = static_cast<u32>(key->face_index)
+            };
+        }
+
+        std::vector<Uint16> DecodeCharset(const std::string &charset) {
+            std::vector<Uint16> codepoints;
+            size_t i = 0;
+            while(i < charset.length()) {
+                const auto ch = static_cast<u8>(charset[i]);
+                u32 cp = 0;
+                size_t cp_len = 1;
+                if(ch < 0x80) {
+                    cp = ch;
+                }
+                else if((ch & 0xE0) == 0xC0) {
+                    cp = ch & 0x1F;
+                    cp_len = 2;
+                }
+                else if((ch & 0xF0) == 0xE0) {
+                    cp = ch & 0x0F;
+                    cp_len = 3;
+                }
+                else {
+                    // Glyphs are only looked up by 16-bit codepoints, skip anything outside the BMP (or invalid)
+                    cp_len = ((ch & 0xF8) == 0xF0) ? 4 : 1;
+                    i += cp_len;
+                    continue;
+                }
+
+                for(size_t j = 1; (j < cp_len) && ((i + j) < charset.length()); j++) {
+                    cp = (cp << 6) | (static_cast<u8>(charset[i + j]) & 0x3F);
+                }
+                codepoints.push_back(static_cast<Uint16>(cp));
+                i += cp_len;
+            }
+            return codepoints;
+        }
+
+        inline bool IsPersistedCodepoint(const u32 cp) {
+            return g_Codepoints.empty() || (g_Codepoints.find(cp) != g_Codepoints.end());
+        }
+
+        // Only fails if the file exists but can't be used as a whole
+        bool ReadGlyphCacheFile() {
+            auto f = fopen(g_Path.c_str(), "rb");
+            if(!f) {
+                return true;
+            }
+
+            fseek(f, 0, SEEK_END);
+            const auto f_size = ftell(f);
+            rewind(f);
+            if(f_size < static_cast<long>(sizeof(GlyphCacheHeader))) {
+                fclose(f);
+                return false;
+            }
+
+            g_FileBuffer = std::make_unique<u8[]>(f_size);
+            const auto read_ok = fread(g_FileBuffer.get(), 1, f_size, f) == static_cast<size_t>(f_size);
+            fclose(f);
+            if(!read_ok) {
+                return false;
+            }
+
+            GlyphCacheHeader header;
+            memcpy(&header, g_FileBuffer.get(), sizeof(header));
+            const auto data = g_FileBuffer.get() + sizeof(header);
+            const auto data_size = static_cast<size_t>(f_size) - sizeof(header);
+            if((header.magic != GlyphCacheMagic) || (header.version != GlyphCacheVersion) || (header.data_size != data_size)) {
+                return false;
+            }
+            auto checksum = HashSeed;
+            HashBytes(checksum, data, data_size);
+            if(checksum != header.checksum) {
+                return false;
+            }
+
+            // The whole file is kept in memory, glyphs are used right from it
+            size_t offset = 0;
+            for(u32 i = 0; i < header.entry_count; i++) {
+                if((offset + sizeof(GlyphCacheEntryHeader)) > data_size) {
+                    return false;
+                }
+
+                GlyphCacheEntryHeader entry_header;
+                memcpy(&entry_header, data + offset, sizeof(entry_header));
+                offset += sizeof(entry_header);
+                if(!IsValidEntry(entry_header)) {
+                    return false;
+                }
+
+                const auto pixmap_size = GetPixmapSize(entry_header.info);
+                if((offset + pixmap_size) > data_size) {
+                    return false;
+                }
+
+                // Glyphs no longer wanted (or past the limits) are dropped when saving again
+                const auto entry_size = GetEntrySize(entry_header.info);
+                if(IsPersistedCodepoint(entry_header.key.codepoint) && (g_EntryTable.size() < MaxEntryCount) && ((g_TotalSize + entry_size) <= MaxTotalSize)) {
+                    auto [it, inserted] = g_EntryTable.try_emplace(entry_header.key);
+                    if(inserted) {
+                        it->second.info = entry_header.info;
+                        it->second.pixmap = data + offset;
+                        g_TotalSize += entry_size;
+                    }
+                }
+                else {
+                    g_Dirty = true;
+                }
+                offset += pixmap_size;
+            }
+            return offset == data_size;
+        }
+
+        void PrewarmFont(std::shared_ptr<Font> font, const std::vector<Uint16> &codepoints, const jobs::CancellationToken &token) {
+            // Only the primary face, fallback faces are rarely used enough to be worth it
+            void *src = nullptr;
+            size_t src_size = 0;
+            if(!font->GetPrimaryFaceSource(src, src_size)) {
+                return;
+            }
+
+            // Opened separately here (sharing the face), so the fonts used for rendering are never touched
+            auto ttf_font = TTF_OpenFontMem(src, src_size, font->GetFontSize());
+            if(ttf_font == nullptr) {
+                return;
+            }
+
+            for(const auto cp : codepoints) {
+                if(token.IsCancelled()) {
+                    break;
+                }
+                if(TTF_GlyphIsProvided(ttf_font, cp)) {
+                    TTF_CacheGlyph(ttf_font, cp);
+                }
+            }
+            TTF_CloseFont(ttf_font);
+        }
+
+    }
+
+    bool LoadGlyphCache(const std::string &path, const std::string &charset) {
+        DisposeGlyphCache();
+        rmutexInit(&g_Lock);
+        g_Path = path;
+        g_Dirty = false;
+        g_TotalSize = 0;
+        for(const auto cp : DecodeCharset(charset)) {
+            g_Codepoints.insert(cp);
+        }
+
+        if(!ReadGlyphCacheFile()) {
+            // Nothing from a corrupted (or outdated) file is used, and it gets replaced on the next save
+            g_EntryTable.clear();
+            g_FileBuffer.reset();
+            g_TotalSize = 0;
+            g_Dirty = true;
+        }
+
+        g_Enabled = true;
+        return true;
+    }
+
+    bool SaveGlyphCache() {
+        if(!g_Enabled) {
+            return false;
+        }
+
+        rmutexLock(&g_Lock);
+        if(!g_Dirty) {
+            rmutexUnlock(&g_Lock);
+            return true;
+        }
+
+        // Written aside first, so that an interrupted save never leaves a partial file behind
+        const auto tmp_path = g_Path + ".tmp";
+        auto f = fopen(tmp_path.c_str(), "wb");
+        if(!f) {
+            rmutexUnlock(&g_Lock);
+            return false;
+        }
+
+        GlyphCacheHeader header = {
+            .magic = GlyphCacheMagic,
+            .version = GlyphCacheVersion,
+            .entry_count = static_cast<u32>(g_EntryTable.size()),
+            .data_size = 0,
+            .checksum = HashSeed
+        };
+        auto ok = fwrite(&header, sizeof(header), 1, f) == 1;
+        for(const auto &[key, entry] : g_EntryTable) {
+            const GlyphCacheEntryHeader entry_header = {
+                .key = key,
+                .info = entry.info
+            };
+            HashBytes(header.checksum, reinterpret_cast<const u8*>(&entry_header), sizeof(entry_header));
+            ok = ok && (fwrite(&entry_header, sizeof(entry_header), 1, f) == 1);
+
+            const auto pixmap_size = GetPixmapSize(entry.info);
+            if(pixmap_size > 0) {
+                HashBytes(header.checksum, entry.pixmap, pixmap_size);
+                ok = ok && (fwrite(entry.pixmap, 1, pixmap_size, f) == pixmap_size);
+            }
+            header.data_size += GetEntrySize(entry.info);
+        }
+
+        // The header is written again once the checksum is known
+        ok = ok && (fseek(f, 0, SEEK_SET) == 0) && (fwrite(&header, sizeof(header), 1, f) == 1);
+        ok = (fclose(f) == 0) && ok;
+
+        // Renaming doesn't replace existing files everywhere, a cache lost in between is just rebuilt
+        if(ok) {
+            remove(g_Path.c_str());
+            ok = rename(tmp_path.c_str(), g_Path.c_str()) == 0;
+        }
+        if(!ok) {
+            remove(tmp_path.c_str());
+            rmutexUnlock(&g_Lock);
+            return false;
+        }
+
+        g_Dirty = false;
+        rmutexUnlock(&g_Lock);
+        return true;
+    }
+
+    void DisposeGlyphCache() {
+        if(g_Enabled) {
+            StopGlyphCachePrewarm();
+            g_Enabled = false;
+            g_EntryTable.clear();
+            g_FileBuffer.reset();
+            g_TotalSize = 0;
+            g_Codepoints.clear();
+            g_Path.clear();
+        }
+    }
+
+    bool StartGlyphCachePrewarm(const std::vector<std::shared_ptr<Font>> &fonts, const std::string &charset) {
+        if(!g_Enabled || !g_PrewarmJobs.empty() || !jobs::IsInitialized()) {
+            return false;
+        }
+
+        // One job per font, so that more urgent jobs (like visible text) never wait long behind prewarming
+        auto codepoints = std::make_shared<std::vector<Uint16>>(DecodeCharset(charset));
+        g_PrewarmToken = jobs::CancellationToken();
+        for(const auto &font : fonts) {
+            g_PrewarmJobs.push_back(jobs::Submit([font, codepoints, token = g_PrewarmToken]() {
+                PrewarmFont(font, *codepoints, token);
+            }, {}, jobs::JobPriority::Low, g_PrewarmToken));
+        }
+        return true;
+    }
+
+    void StopGlyphCachePrewarm() {
+        if(!g_PrewarmJobs.empty()) {
+            g_PrewarmToken.Cancel();
+            for(const auto &job : g_PrewarmJobs) {
+                job.Wait();
+            }
+            g_PrewarmJobs.clear();
+        }
+    }
+
+}
+
+extern "C" {
+
+    Uint64 TTF_CppWrap_ComputeFontHash(const void *src, size_t src_size) {
+        using namespace pu::ttf;
+        auto hash = HashSeed;
+        const auto src_buf = reinterpret_cast<const u8*>(src);
+        const auto sample_size = std::min(src_size, FontHashSampleSize);
+        HashBytes(hash, reinterpret_cast<const u8*>(&src_size), sizeof(src_size));
+        HashBytes(hash, src_buf, sample_size);
+        HashBytes(hash, src_buf + src_size - sample_size, sample_size);
+        return hash;
+    }
+
+    int TTF_CppWrap_FindCachedGlyph(const TTF_CachedGlyphKey *key, TTF_CachedGlyphInfo *out_info, const Uint8 **out_pixmap) {
+        using namespace pu::ttf;
+        if(!g_Enabled) {
+            return 0;
+        }
+
+        rmutexLock(&g_Lock);
+        auto it = g_EntryTable.find(MakeKey(key));
+        const auto found = it != g_EntryTable.end();
+        if(found) {
+            *out_info = it->second.info;
+            *out_pixmap = it->second.pixmap;
+        }
+        rmutexUnlock(&g_Lock);
+        return found ? 1 : 0;
+    }
+
+    void TTF_CppWrap_StoreCachedGlyph(const TTF_CachedGlyphKey *key, const TTF_CachedGlyphInfo *info, const Uint8 *pixmap) {
+        using namespace pu::ttf;
+        if(!g_Enabled) {
+            return;
+        }
+
+        const GlyphCacheEntryHeader entry_header = {
+            .key = MakeKey(key),
+            .info = *info
+        };
+        if(!IsValidEntry(entry_header)) {
+            return;
+        }
+
+        rmutexLock(&g_Lock);
+        const auto entry_size = GetEntrySize(*info);
+        if(!IsPersistedCodepoint(key->ch) || (g_EntryTable.size() >= MaxEntryCount) || ((g_TotalSize + entry_size) > MaxTotalSize)) {
+            rmutexUnlock(&g_Lock);
+            return;
+        }
+
+        auto [it, inserted] = g_EntryTable.try_emplace(entry_header.key);
+        if(!inserted) {
+            // Another thread got to it first, and its pixmap may be in use already
+            rmutexUnlock(&g_Lock);
+            return;
+        }
+
+        auto &entry = it->second;
+        entry.info = *info;
+        const auto pixmap_size = GetPixmapSize(*info);
+        if(pixmap_size > 0) {
+            entry.own_pixmap = std::make_unique<u8[]>(pixmap_size);
+            memcpy(entry.own_pixmap.get(), pixmap, pixmap_size);
+        }
+        else {
+            entry.own_pixmap.reset();
+        }
+        entry.pixmap = entry.own_pixmap.get();
+        g_TotalSize += entry_size;
+        g_Dirty = true;
+        rmutexUnlock(&g_Lock);
+    }
+
+}
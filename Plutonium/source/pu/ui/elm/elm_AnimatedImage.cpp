@@ -0,0 +1,220 @@
+#include <pu/ui/elm/elm_AnimatedImage.hpp>
+#include <webp/demux.h>
+#include <algorithm>
+#include <cstring>
+
+namespace pu::ui::elm {
+
+    AnimatedImage::AnimatedImage(const i32 x, const i32 y, const std::string &path) : Element() {
+        this->x = x;
+        this->y = y;
+        this->rend_opts = render::TextureRenderOptions::Default();
+        this->decoder = nullptr;
+        this->canvas_width = 0;
+        this->canvas_height = 0;
+        this->loop_count = 0;
+        this->frame_count = 0;
+        this->decoder_running = false;
+        this->decoder_exit = false;
+        this->frame_ring_start = 0;
+        this->frame_ring_count = 0;
+        this->tex = nullptr;
+        this->started = false;
+        mutexInit(&this->lock);
+        condvarInit(&this->cond_var);
+
+        // The decoder reads frames straight from the (compressed) file data, so it's kept loaded
+        auto f = fopen(path.c_str(), "rb");
+        if(f) {
+            fseek(f, 0, SEEK_END);
+            const auto f_size = ftell(f);
+            rewind(f);
+            if(f_size > 0) {
+                this->img_data.resize(f_size);
+                if(fread(this->img_data.data(), 1, f_size, f) != static_cast<size_t>(f_size)) {
+                    this->img_data.clear();
+                }
+            }
+            fclose(f);
+        }
+        if(this->img_data.empty()) {
+            return;
+        }
+
+        WebPAnimDecoderOptions dec_opts;
+        if(!WebPAnimDecoderOptionsInit(&dec_opts)) {
+            return;
+        }
+        dec_opts.color_mode = MODE_RGBA;
+        dec_opts.use_threads = 0;
+
+        WebPData webp_data;
+        WebPDataInit(&webp_data);
+        webp_data.bytes = this->img_data.data();
+        webp_data.size = this->img_data.size();
+        this->decoder = WebPAnimDecoderNew(&webp_data, &dec_opts);
+        if(this->decoder == nullptr) {
+            return;
+        }
+
+        WebPAnimInfo anim_info;
+        if(!WebPAnimDecoderGetInfo(this->decoder, &anim_info) || (anim_info.canvas_width == 0) || (anim_info.canvas_height == 0)) {
+            WebPAnimDecoderDelete(this->decoder);
+            this->decoder = nullptr;
+            return;
+        }
+        this->canvas_width = anim_info.canvas_width;
+        this->canvas_height = anim_info.canvas_height;
+        this->loop_count = anim_info.loop_count;
+        this->frame_count = anim_info.frame_count;
+        this->rend_opts.width = this->canvas_width;
+        this->rend_opts.height = this->canvas_height;
+
+        // Every buffer is allocated once here, and reused for every frame
+        for(auto &frame : this->frame_ring) {
+            frame.pixels.resize(this->canvas_width * this->canvas_height * 4);
+            frame.start_ms = 0;
+        }
+
+        if(R_SUCCEEDED(threadCreate(&this->decoder_thread, DecoderMain, this, nullptr, DecoderStackSize, DecoderPriority, -2))) {
+            if(R_SUCCEEDED(threadStart(&this->decoder_thread))) {
+                this->decoder_running = true;
+            }
+            else {
+                threadClose(&this->decoder_thread);
+            }
+        }
+    }
+
+    AnimatedImage::~AnimatedImage() {
+        if(this->decoder_running) {
+            mutexLock(&this->lock);
+            this->decoder_exit = true;
+            condvarWakeAll(&this->cond_var);
+            mutexUnlock(&this->lock);
+
+            threadWaitForExit(&this->decoder_thread);
+            threadClose(&this->decoder_thread);
+        }
+        if(this->decoder != nullptr) {
+            WebPAnimDecoderDelete(this->decoder);
+        }
+        render::DeleteTexture(this->tex);
+    }
+
+    void AnimatedImage::DecoderMain(void *anim_img_ptr) {
+        auto anim_img = reinterpret_cast<AnimatedImage*>(anim_img_ptr);
+        u64 cur_time_ms = 0;
+        i32 prev_timestamp = 0;
+        u32 loop_idx = 0;
+        while(true) {
+            if(!WebPAnimDecoderHasMoreFrames(anim_img->decoder)) {
+                // A loop count of zero means looping forever, and still images are only decoded once
+                loop_idx++;
+                if((anim_img->frame_count <= 1) || ((anim_img->loop_count > 0) && (loop_idx >= anim_img->loop_count))) {
+                    break;
+                }
+                WebPAnimDecoderReset(anim_img->decoder);
+                prev_timestamp = 0;
+            }
+
+            mutexLock(&anim_img->lock);
+            while((anim_img->frame_ring_count == FrameRingSize) && !anim_img->decoder_exit) {
+                condvarWait(&anim_img->cond_var, &anim_img->lock);
+            }
+            const auto exit = anim_img->decoder_exit;
+            const auto frame_idx = (anim_img->frame_ring_start + anim_img->frame_ring_count) % FrameRingSize;
+            mutexUnlock(&anim_img->lock);
+            if(exit) {
+                break;
+            }
+
+            u8 *frame_buf;
+            i32 timestamp;
+            if(!WebPAnimDecoderGetNext(anim_img->decoder, &frame_buf, &timestamp)) {
+                break;
+            }
+
+            // Timestamps are when each frame ends, counted from the start of the current loop
+            auto &frame = anim_img->frame_ring.at(frame_idx);
+            std::memcpy(frame.pixels.data(), frame_buf, frame.pixels.size());
+            frame.start_ms = cur_time_ms;
+            auto duration_ms = static_cast<u64>(std::max(timestamp - prev_timestamp, 0));
+            if(duration_ms <= MinFrameDurationMs) {
+                duration_ms = DefaultFrameDurationMs;
+            }
+            cur_time_ms += duration_ms;
+            prev_timestamp = timestamp;
+
+            mutexLock(&anim_img->lock);
+            anim_img->frame_ring_count++;
+            mutexUnlock(&anim_img->lock);
+        }
+    }
+
+    void AnimatedImage::UploadFrame(const Frame &frame) {
+        void *tex_pixels;
+        i32 tex_pitch;
+        if(SDL_LockTexture(this->tex, nullptr, &tex_pixels, &tex_pitch) == 0) {
+            const auto row_size = this->canvas_width * 4;
+            for(u32 i = 0; i < this->canvas_height; i++) {
+                std::memcpy(reinterpret_cast<u8*>(tex_pixels) + i * tex_pitch, frame.pixels.data() + i * row_size, row_size);
+            }
+            SDL_UnlockTexture(this->tex);
+        }
+    }
+
+    void AnimatedImage::OnRender(render::Renderer::Ref &drawer, const i32 x, const i32 y) {
+        if(this->decoder == nullptr) {
+            return;
+        }
+
+        if(this->tex == nullptr) {
+            this->tex = SDL_CreateTexture(render::GetMainRenderer(), SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, this->canvas_width, this->canvas_height);
+            if(this->tex == nullptr) {
+                return;
+            }
+            render::TrackTexture(this->tex, "AnimatedImage");
+            SDL_SetTextureBlendMode(this->tex, SDL_BLENDMODE_BLEND);
+        }
+
+        // The animation starts once the first frame is ready
+        const auto now = std::chrono::steady_clock::now();
+        const auto elapsed_ms = this->started ? static_cast<u64>(std::chrono::duration_cast<std::chrono::milliseconds>(now - this->start_time).count()) : 0;
+
+        mutexLock(&this->lock);
+        // When behind, frames whose successor is also due are dropped without ever being uploaded
+        auto skipped_frames = false;
+        while((this->frame_ring_count > 1) && (this->frame_ring.at((this->frame_ring_start + 1) % FrameRingSize).start_ms <= elapsed_ms)) {
+            this->frame_ring_start = (this->frame_ring_start + 1) % FrameRingSize;
+            this->frame_ring_count--;
+            skipped_frames = true;
+        }
+        const auto has_due_frame = (this->frame_ring_count > 0) && (this->frame_ring.at(this->frame_ring_start).start_ms <= elapsed_ms);
+        const auto due_frame_idx = this->frame_ring_start;
+        if(skipped_frames) {
+            condvarWakeOne(&this->cond_var);
+        }
+        mutexUnlock(&this->lock);
+
+        if(has_due_frame) {
+            // The decoder never writes to a frame still in the ring, so it's uploaded without holding the lock
+            this->UploadFrame(this->frame_ring.at(due_frame_idx));
+            if(!this->started) {
+                this->started = true;
+                this->start_time = now;
+            }
+
+            mutexLock(&this->lock);
+            this->frame_ring_start = (this->frame_ring_start + 1) % FrameRingSize;
+            this->frame_ring_count--;
+            condvarWakeOne(&this->cond_var);
+            mutexUnlock(&this->lock);
+        }
+
+        if(this->started) {
+            drawer->RenderTexture(this->tex, x, y, this->rend_opts);
+        }
+    }
+
+}
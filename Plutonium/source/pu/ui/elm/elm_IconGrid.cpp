@@ -0,0 +1,411 @@
+#include <pu/ui/elm/elm_IconGrid.hpp>
+#include <algorithm>
+
+namespace pu::ui::elm {
+
+    struct IconGrid::TileLoadState {
+        struct Result {
+            u32 idx;
+            sdl2::Surface tile;
+        };
+
+        Mutex lock;
+        // Bumped whenever the slots are reset, so that loads started before are dropped
+        u64 generation;
+        // Item being loaded into each slot, if any
+        std::vector<i32> slot_loads;
+        std::vector<Result> results;
+
+        TileLoadState() : generation(0), slot_loads(), results() {
+            mutexInit(&this->lock);
+        }
+
+        ~TileLoadState() {
+            this->DiscardResults();
+        }
+
+        void DiscardResults() {
+            for(auto &result : this->results) {
+                SDL_FreeSurface(result.tile);
+            }
+            this->results.clear();
+        }
+
+        void Reset(const u32 slot_count) {
+            mutexLock(&this->lock);
+            this->generation++;
+            this->slot_loads.assign(slot_count, -1);
+            this->DiscardResults();
+            mutexUnlock(&this->lock);
+        }
+
+        bool StartLoad(const u32 idx, u64 &out_generation) {
+            mutexLock(&this->lock);
+            auto &slot_load = this->slot_loads.at(idx % this->slot_loads.size());
+            const auto already_loading = slot_load == static_cast<i32>(idx);
+            slot_load = idx;
+            out_generation = this->generation;
+            mutexUnlock(&this->lock);
+            return !already_loading;
+        }
+
+        // Called with the lock held, the generation is checked first since slots may have been reset to none
+        inline bool IsLoadWantedImpl(const u64 generation, const u32 idx) {
+            return (generation == this->generation) && (this->slot_loads.at(idx % this->slot_loads.size()) == static_cast<i32>(idx));
+        }
+
+        // Loads whose slot was taken by another item (or reset) while queued are skipped, so scrolling far doesn't pile up work
+        bool IsLoadWanted(const u64 generation, const u32 idx) {
+            mutexLock(&this->lock);
+            const auto wanted = this->IsLoadWantedImpl(generation, idx);
+            mutexUnlock(&this->lock);
+            return wanted;
+        }
+
+        // Failed loads (without a tile) just free the slot, so they're tried again later
+        void FinishLoad(const u64 generation, const u32 idx, sdl2::Surface tile) {
+            mutexLock(&this->lock);
+            if(this->IsLoadWantedImpl(generation, idx)) {
+                this->slot_loads.at(idx % this->slot_loads.size()) = -1;
+                if(tile != nullptr) {
+                    this->results.push_back({ idx, tile });
+                    tile = nullptr;
+                }
+            }
+            mutexUnlock(&this->lock);
+
+            if(tile != nullptr) {
+                SDL_FreeSurface(tile);
+            }
+        }
+
+        std::vector<Result> TakeResults() {
+            mutexLock(&this->lock);
+            auto results = std::move(this->results);
+            this->results.clear();
+            mutexUnlock(&this->lock);
+            return results;
+        }
+    };
+
+    namespace {
+
+        // Icons are fitted into the tile keeping their aspect ratio, the rest of it is left transparent
+        sdl2::Surface MakeTileSurface(sdl2::Surface icon, const i32 tile_size) {
+            auto tile = SDL_CreateRGBSurfaceWithFormat(0, tile_size, tile_size, 32, SDL_PIXELFORMAT_RGBA32);
+            if(tile == nullptr) {
+                if(icon != nullptr) {
+                    SDL_FreeSurface(icon);
+                }
+                return nullptr;
+            }
+
+            SDL_FillRect(tile, nullptr, 0);
+            if((icon != nullptr) && (icon->w > 0) && (icon->h > 0)) {
+                auto icon_w = tile_size;
+                auto icon_h = tile_size;
+                if(icon->w > icon->h) {
+                    icon_h = std::max((tile_size * icon->h) / icon->w, 1);
+                }
+                else {
+                    icon_w = std::max((tile_size * icon->w) / icon->h, 1);
+                }
+
+                auto resized_icon = render::ResizeSurface(icon, icon_w, icon_h);
+                if(resized_icon != nullptr) {
+                    SDL_Rect dst_rect = { (tile_size - icon_w) / 2, (tile_size - icon_h) / 2, icon_w, icon_h };
+                    SDL_SetSurfaceBlendMode(resized_icon, SDL_BLENDMODE_NONE);
+                    SDL_BlitSurface(resized_icon, nullptr, tile, &dst_rect);
+                    SDL_FreeSurface(resized_icon);
+                }
+            }
+            if(icon != nullptr) {
+                SDL_FreeSurface(icon);
+            }
+
+            return render::NormalizeSurface(tile);
+        }
+
+    }
+
+    IconGrid::IconGrid(const i32 x, const i32 y, const u32 columns, const u32 rows_to_show, const i32 tile_size) : Element() {
+        this->x = x;
+        this->y = y;
+        this->columns = std::max(columns, 1u);
+        this->rows_to_show = std::max(rows_to_show, 1u);
+        this->tile_size = tile_size;
+        this->tile_margin = DefaultTileMargin;
+        this->focus_clr = DefaultFocusColor;
+        this->focus_border_width = DefaultFocusBorderWidth;
+        this->focus_border_radius = DefaultFocusBorderRadius;
+        this->prefetch_row_count = DefaultPrefetchRowCount;
+        this->max_tile_loads_per_frame = DefaultMaxTileLoadsPerFrame;
+        this->data_src = nullptr;
+        this->on_selection_changed_cb = {};
+        this->selected_idx = 0;
+        this->first_row = 0;
+        this->scroll_offset = 0;
+        this->item_touched = false;
+        this->atlas = nullptr;
+        this->tile_load_state = std::make_shared<TileLoadState>();
+    }
+
+    IconGrid::~IconGrid() {
+        // Jobs still queued keep the state alive, but are skipped since their loads are no longer wanted
+        this->tile_load_state->Reset(0);
+        render::DeleteTexture(this->atlas);
+    }
+
+    void IconGrid::ResetAtlas() {
+        // Recreated (with every icon loaded again) on the next render
+        render::DeleteTexture(this->atlas);
+        this->slot_items.clear();
+        this->ResetSlots();
+    }
+
+    void IconGrid::ResetSlots() {
+        std::fill(this->slot_items.begin(), this->slot_items.end(), -1);
+        this->tile_load_state->Reset(this->slot_items.size());
+    }
+
+    bool IconGrid::LoadTile(const u32 idx, const jobs::JobPriority prio) {
+        u64 generation = 0;
+        if(!this->tile_load_state->StartLoad(idx, generation)) {
+            return false;
+        }
+
+        jobs::Submit([state = this->tile_load_state, data_src = this->data_src, idx, generation, tile_size = this->tile_size]() {
+            if(state->IsLoadWanted(generation, idx)) {
+                state->FinishLoad(generation, idx, MakeTileSurface(data_src->LoadItemIcon(idx), tile_size));
+            }
+        }, {}, prio);
+        return true;
+    }
+
+    void IconGrid::UploadLoadedTiles() {
+        for(const auto &[idx, tile] : this->tile_load_state->TakeResults()) {
+            const auto slot = idx % this->slot_items.size();
+            const auto slot_rect = this->GetSlotRect(slot);
+            SDL_UpdateTexture(this->atlas, &slot_rect, tile->pixels, tile->pitch);
+            SDL_FreeSurface(tile);
+            this->slot_items.at(slot) = idx;
+        }
+    }
+
+    void IconGrid::UpdateTiles() {
+        const auto item_count = this->GetItemCount();
+        if(item_count == 0) {
+            return;
+        }
+
+        if(this->atlas == nullptr) {
+            const auto atlas_row_count = this->GetAtlasRowCount();
+            this->atlas = SDL_CreateTexture(render::GetMainRenderer(), SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STATIC, this->columns * this->tile_size, atlas_row_count * this->tile_size);
+            if(this->atlas == nullptr) {
+                return;
+            }
+            render::TrackTexture(this->atlas, "IconGrid");
+            SDL_SetTextureBlendMode(this->atlas, render::GetNormalizedBlendMode());
+            this->slot_items.assign(this->columns * atlas_row_count, -1);
+            this->ResetSlots();
+        }
+
+        this->UploadLoadedTiles();
+
+        // Visible rows are loaded first (and ahead of other background work), then the prefetched ones, only a few per frame
+        const auto stride = this->GetTileStride();
+        const auto row_count = (item_count + this->columns - 1) / this->columns;
+        const auto visible_start_row = static_cast<u32>(this->scroll_offset / stride);
+        const auto visible_end_row = std::min(static_cast<u32>((this->scroll_offset + this->GetHeight() - 1) / stride) + 1, row_count);
+        const auto start_row = (visible_start_row > this->prefetch_row_count) ? (visible_start_row - this->prefetch_row_count) : 0;
+        const auto end_row = std::min(visible_end_row + this->prefetch_row_count, row_count);
+
+        u32 load_count = 0;
+        const auto load_rows = [&](const u32 row_start, const u32 row_end, const jobs::JobPriority prio) {
+            for(u32 row = row_start; row < row_end; row++) {
+                for(u32 idx = row * this->columns; idx < std::min((row + 1) * this->columns, item_count); idx++) {
+                    if(load_count >= this->max_tile_loads_per_frame) {
+                        return;
+                    }
+                    if((this->slot_items.at(idx % this->slot_items.size()) != static_cast<i32>(idx)) && this->LoadTile(idx, prio)) {
+                        load_count++;
+                    }
+                }
+            }
+        };
+        load_rows(visible_start_row, visible_end_row, jobs::JobPriority::High);
+        load_rows(visible_end_row, end_row, jobs::JobPriority::Low);
+        load_rows(start_row, visible_start_row, jobs::JobPriority::Low);
+    }
+
+    void IconGrid::SetSelectedIndexImpl(const u32 idx) {
+        const auto changed = idx != this->selected_idx;
+        this->selected_idx = idx;
+
+        // Only the offset changes when scrolling, tiles already loaded stay where they are
+        const auto selected_row = idx / this->columns;
+        if(selected_row < this->first_row) {
+            this->first_row = selected_row;
+        }
+        else if(selected_row >= (this->first_row + this->rows_to_show)) {
+            this->first_row = selected_row - this->rows_to_show + 1;
+        }
+
+        if(changed && this->on_selection_changed_cb) {
+            (this->on_selection_changed_cb)();
+        }
+    }
+
+    void IconGrid::SetColumns(const u32 columns) {
+        this->columns = std::max(columns, 1u);
+        this->ResetAtlas();
+        this->ForceReloadItems();
+    }
+
+    void IconGrid::SetRowsToShow(const u32 rows_to_show) {
+        this->rows_to_show = std::max(rows_to_show, 1u);
+        this->ResetAtlas();
+        this->ForceReloadItems();
+    }
+
+    void IconGrid::SetTileSize(const i32 tile_size) {
+        this->tile_size = tile_size;
+        this->ResetAtlas();
+    }
+
+    void IconGrid::SetPrefetchRowCount(const u32 count) {
+        this->prefetch_row_count = count;
+        this->ResetAtlas();
+    }
+
+    void IconGrid::SetDataSource(std::shared_ptr<IconGridDataSource> data_src) {
+        this->data_src = data_src;
+        this->selected_idx = 0;
+        this->first_row = 0;
+        this->scroll_offset = 0;
+        this->ForceReloadItems();
+    }
+
+    void IconGrid::ForceReloadItems() {
+        this->ResetSlots();
+
+        const auto item_count = this->GetItemCount();
+        if(this->selected_idx >= item_count) {
+            this->SetSelectedIndexImpl((item_count > 0) ? (item_count - 1) : 0);
+        }
+        else {
+            this->SetSelectedIndexImpl(this->selected_idx);
+        }
+    }
+
+    void IconGrid::SetSelectedIndex(const u32 idx) {
+        if(idx < this->GetItemCount()) {
+            this->SetSelectedIndexImpl(idx);
+        }
+    }
+
+    void IconGrid::OnRender(render::Renderer::Ref &drawer, const i32 x, const i32 y) {
+        const auto item_count = this->GetItemCount();
+        if(item_count == 0) {
+            return;
+        }
+
+        const auto stride = this->GetTileStride();
+        const auto target_offset = static_cast<i32>(this->first_row) * stride;
+        const auto offset_diff = target_offset - this->scroll_offset;
+        if(std::abs(offset_diff) < ScrollSmoothFactor) {
+            this->scroll_offset = target_offset;
+        }
+        else {
+            this->scroll_offset += offset_diff / ScrollSmoothFactor;
+        }
+
+        this->UpdateTiles();
+
+        const auto width = this->GetWidth();
+        const auto height = this->GetHeight();
+        const auto start_row = static_cast<u32>(this->scroll_offset / stride);
+        const auto end_row = static_cast<u32>((this->scroll_offset + height - 1) / stride) + 1;
+        const auto get_tile_x = [&](const u32 idx) {
+            return x + this->tile_margin + static_cast<i32>(idx % this->columns) * stride;
+        };
+        const auto get_tile_y = [&](const u32 idx) {
+            return y + this->tile_margin + static_cast<i32>(idx / this->columns) * stride - this->scroll_offset;
+        };
+
+        drawer->SetClipRectangle(x, y, width, height);
+
+        // The focus is drawn first, so that nothing interrupts the batch of tiles drawn from the atlas below
+        const auto selected_row = this->selected_idx / this->columns;
+        if((selected_row >= start_row) && (selected_row < end_row)) {
+            drawer->RenderRoundedRectangleFill(this->focus_clr, get_tile_x(this->selected_idx) - this->focus_border_width, get_tile_y(this->selected_idx) - this->focus_border_width, this->tile_size + 2 * this->focus_border_width, this->tile_size + 2 * this->focus_border_width, this->focus_border_radius);
+        }
+
+        if(this->atlas != nullptr) {
+            const auto end_idx = std::min(end_row * this->columns, item_count);
+            for(u32 idx = start_row * this->columns; idx < end_idx; idx++) {
+                const auto slot = idx % this->slot_items.size();
+                if(this->slot_items.at(slot) == static_cast<i32>(idx)) {
+                    drawer->RenderTextureRegion(this->atlas, this->GetSlotRect(slot), get_tile_x(idx), get_tile_y(idx), this->tile_size, this->tile_size);
+                }
+            }
+        }
+
+        drawer->ResetClipRectangle();
+    }
+
+    void IconGrid::OnInput(const u64 keys_down, const u64 keys_up, const u64 keys_held, const TouchPoint touch_pos) {
+        const auto item_count = this->GetItemCount();
+        if(item_count == 0) {
+            return;
+        }
+
+        if(!touch_pos.IsEmpty()) {
+            // Hit-tested arithmetically against the grid instead of against every tile
+            const auto stride = this->GetTileStride();
+            const auto rel_x = touch_pos.x - this->GetProcessedX() - this->tile_margin;
+            const auto rel_y = touch_pos.y - this->GetProcessedY() - this->tile_margin;
+            if((rel_x >= 0) && (rel_y >= 0) && (rel_y < (this->GetHeight() - this->tile_margin))) {
+                const auto content_y = rel_y + this->scroll_offset;
+                const auto col = static_cast<u32>(rel_x / stride);
+                const auto idx = static_cast<u32>(content_y / stride) * this->columns + col;
+                if((col < this->columns) && ((rel_x % stride) < this->tile_size) && ((content_y % stride) < this->tile_size) && (idx < item_count)) {
+                    this->SetSelectedIndexImpl(idx);
+                    this->item_touched = true;
+                }
+            }
+        }
+        else if(this->item_touched) {
+            this->item_touched = false;
+            this->data_src->OnItemKey(this->selected_idx, TouchPseudoKey);
+        }
+        else if(keys_down & HidNpadButton_AnyLeft) {
+            if((this->selected_idx % this->columns) > 0) {
+                this->SetSelectedIndexImpl(this->selected_idx - 1);
+            }
+        }
+        else if(keys_down & HidNpadButton_AnyRight) {
+            if((((this->selected_idx % this->columns) + 1) < this->columns) && ((this->selected_idx + 1) < item_count)) {
+                this->SetSelectedIndexImpl(this->selected_idx + 1);
+            }
+        }
+        else if(keys_down & HidNpadButton_AnyUp) {
+            if(this->selected_idx >= this->columns) {
+                this->SetSelectedIndexImpl(this->selected_idx - this->columns);
+            }
+        }
+        else if(keys_down & HidNpadButton_AnyDown) {
+            if((this->selected_idx + this->columns) < item_count) {
+                this->SetSelectedIndexImpl(this->selected_idx + this->columns);
+            }
+            else if((this->selected_idx / this->columns) < ((item_count - 1) / this->columns)) {
+                // The last row may be shorter
+                this->SetSelectedIndexImpl(item_count - 1);
+            }
+        }
+        else if(keys_down != 0) {
+            this->data_src->OnItemKey(this->selected_idx, keys_down);
+        }
+    }
+
+}
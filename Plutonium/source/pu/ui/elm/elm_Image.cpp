@@ -14,14 +14,14 @@ namespace pu::ui::elm {
     void Image::SetImage(sdl2::TextureHandle::Ref image) {
         this->img_tex = image;
         if(this->img_tex != nullptr) {
-            this->rend_opts.width = render::GetTextureWidth(this->img_tex->Get());
-            this->rend_opts.height = render::GetTextureHeight(this->img_tex->Get());
+            this->rend_opts.width = this->img_tex->GetWidth();
+            this->rend_opts.height = this->img_tex->GetHeight();
         }
     }
 
     void Image::OnRender(render::Renderer::Ref &drawer, const i32 x, const i32 y) {
         if(this->img_tex != nullptr) {
-            drawer->RenderTexture(this->img_tex->Get(), x, y, this->rend_opts);
+            drawer->RenderTexture(this->img_tex, x, y, this->rend_opts);
         }
     }
 
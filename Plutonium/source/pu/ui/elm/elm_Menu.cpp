@@ -12,27 +12,237 @@ namespace pu::ui::elm {
         this->icon = icon;
     }
 
-    void Menu::ReloadItemRenders() {
-        for(auto &name_tex : this->loaded_name_texs) {
-            render::DeleteTexture(name_tex);
+    namespace {
+
+        template<typename T>
+        inline void DeleteBatches(T *batch) {
+            while(batch != nullptr) {
+                auto next_batch = batch->next;
+                delete batch;
+                batch = next_batch;
+            }
+        }
+
+    }
+
+    MenuItemDataSource::~MenuItemDataSource() {
+        DeleteBatches(this->pending_batches.exchange(nullptr, std::memory_order_acquire));
+    }
+
+    void MenuItemDataSource::ClearItems() {
+        this->items.clear();
+        DeleteBatches(this->pending_batches.exchange(nullptr, std::memory_order_acquire));
+        this->merging_batches.clear();
+        this->merging_batch_offset = 0;
+    }
+
+    void MenuItemDataSource::PushItemBatch(std::vector<MenuItem::Ref> items) {
+        if(items.empty()) {
+            return;
+        }
+
+        auto batch = new PendingBatch{ std::move(items), this->pending_batches.load(std::memory_order_relaxed) };
+        while(!this->pending_batches.compare_exchange_weak(batch->next, batch, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    bool MenuItemDataSource::PollChanges(u32 &selected_idx) {
+        // Take every pushed batch at once, and restore the order they were pushed in
+        auto batch = this->pending_batches.exchange(nullptr, std::memory_order_acquire);
+        PendingBatch *ordered_batch = nullptr;
+        while(batch != nullptr) {
+            auto next_batch = batch->next;
+            batch->next = ordered_batch;
+            ordered_batch = batch;
+            batch = next_batch;
+        }
+        while(ordered_batch != nullptr) {
+            auto next_batch = ordered_batch->next;
+            this->merging_batches.push_back(std::move(ordered_batch->items));
+            delete ordered_batch;
+            ordered_batch = next_batch;
+        }
+
+        if(this->merging_batches.empty()) {
+            return false;
+        }
+
+        // Items are only appended, so the selected index stays valid
+        // The clock is only checked every few items, since merging a single one is way cheaper
+        constexpr size_t MergeChunkSize = 64;
+        const auto start_time = std::chrono::steady_clock::now();
+        while(!this->merging_batches.empty()) {
+            auto &merging_batch = this->merging_batches.front();
+            const auto chunk_end = std::min(this->merging_batch_offset + MergeChunkSize, merging_batch.size());
+            this->items.insert(this->items.end(), std::make_move_iterator(merging_batch.begin() + this->merging_batch_offset), std::make_move_iterator(merging_batch.begin() + chunk_end));
+            this->merging_batch_offset = chunk_end;
+            if(this->merging_batch_offset == merging_batch.size()) {
+                this->merging_batches.pop_front();
+                this->merging_batch_offset = 0;
+            }
+
+            const auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+            if(elapsed_us >= this->merge_budget_us) {
+                break;
+            }
         }
-        this->loaded_name_texs.clear();
-    
+        return true;
+    }
+
+    void MenuItemDataSource::OnItemKey(const u32 idx, const u64 keys) {
+        auto item = this->items.at(idx);
+        const auto cb_count = item->GetOnKeyCallbackCount();
+        for(u32 i = 0; i < cb_count; i++) {
+            if(keys & item->GetOnKeyCallbackKey(i)) {
+                auto cb = item->GetOnKeyCallback(i);
+                if(cb) {
+                    cb();
+                }
+            }
+        }
+    }
+
+    void Menu::UpdateLoadedRows() {
+        const auto total_item_count = this->GetTotalItemCount();
         const auto item_count = this->GetItemCount();
-        for(u32 i = this->advanced_item_count; i < (this->advanced_item_count + item_count); i++) {
-            auto &item = this->items.at(i);
-            auto name_tex = render::RenderText(this->font_name, item->GetName(), item->GetColor());
-            this->loaded_name_texs.push_back(name_tex);
+        const auto rows_start = (this->advanced_item_count > this->prefetch_item_count) ? (this->advanced_item_count - this->prefetch_item_count) : 0;
+        const auto rows_end = std::min(this->advanced_item_count + item_count + this->prefetch_item_count, total_item_count);
+
+        // Slide the loaded rows along: rows scrolled away are dropped (with any render still pending for them),
+        // and rows still in range keep their data and texture, so scrolling by one row only loads the exposed one
+        while(!this->loaded_rows.empty() && (this->loaded_rows_start < rows_start)) {
+            this->loaded_rows.pop_front();
+            this->loaded_rows_start++;
+        }
+        while(!this->loaded_rows.empty() && ((this->loaded_rows_start + this->loaded_rows.size()) > rows_end)) {
+            this->loaded_rows.pop_back();
+        }
+        if(this->loaded_rows.empty()) {
+            this->loaded_rows_start = rows_start;
+        }
+        while(this->loaded_rows_start > rows_start) {
+            this->loaded_rows.emplace_front();
+            this->loaded_rows_start--;
+        }
+        while((this->loaded_rows_start + this->loaded_rows.size()) < rows_end) {
+            this->loaded_rows.emplace_back();
+        }
+
+        for(u32 i = 0; i < this->loaded_rows.size(); i++) {
+            auto &row = this->loaded_rows.at(i);
+            if(!row.valid) {
+                const auto idx = this->loaded_rows_start + i;
+                auto name = this->data_src->GetItemName(idx);
+                const auto clr = this->data_src->GetItemColor(idx);
+                // Rows reloaded with the same contents (like after filtering) don't need to be rendered again
+                const auto same_name = (name == row.name) && (clr.r == row.clr.r) && (clr.g == row.clr.g) && (clr.b == row.clr.b) && (clr.a == row.clr.a);
+                row.valid = true;
+                row.name = std::move(name);
+                row.clr = clr;
+                row.icon = this->data_src->GetItemIcon(idx);
+                row.name_requested = row.name_requested && same_name;
+            }
+        }
+    }
+
+    void Menu::RequestRowRenders() {
+        const auto request_row_render = [&](LoadedRow &row) {
+            if(!row.name_requested) {
+                // Rows being reloaded keep their current texture until their new name is rendered
+                if(row.name_tex == nullptr) {
+                    row.name_tex = std::make_unique<render::TextTexture>();
+                }
+                row.name_tex->Request(this->font_name, row.name, row.clr);
+                row.name_requested = true;
+            }
+        };
+
+        // Requests are only made here, so several steps between two frames (like while a direction is held) are coalesced
+        // and rows which were scrolled past meanwhile are never rendered
+        const auto visible_start = this->advanced_item_count - this->loaded_rows_start;
+        const auto visible_end = visible_start + this->GetItemCount();
+        for(u32 i = visible_start; i < visible_end; i++) {
+            request_row_render(this->loaded_rows.at(i));
+        }
+
+        // Rows about to be exposed are rendered ahead, after the visible ones
+        if(this->last_moved_up) {
+            for(u32 i = visible_start; i > 0; i--) {
+                request_row_render(this->loaded_rows.at(i - 1));
+            }
+        }
+        else {
+            for(u32 i = visible_end; i < this->loaded_rows.size(); i++) {
+                request_row_render(this->loaded_rows.at(i));
+            }
+        }
+    }
+
+    void Menu::InvalidateLoadedRows() {
+        for(auto &row : this->loaded_rows) {
+            row.valid = false;
+        }
+    }
+
+    void Menu::ForceReloadItems() {
+        // The item count may have changed meanwhile
+        const auto total_item_count = this->GetTotalItemCount();
+        if(this->selected_item_idx >= total_item_count) {
+            this->selected_item_idx = (total_item_count > 0) ? (total_item_count - 1) : 0;
+        }
+        if(static_cast<u32>(this->prev_selected_item_idx) >= total_item_count) {
+            this->prev_selected_item_idx = this->selected_item_idx;
+        }
+        if((this->advanced_item_count + this->items_to_show) > total_item_count) {
+            this->advanced_item_count = (total_item_count > this->items_to_show) ? (total_item_count - this->items_to_show) : 0;
+        }
+
+        this->InvalidateLoadedRows();
+        this->UpdateLoadedRows();
+    }
+
+    void Menu::ApplyItemChanges(const u32 new_selected_idx) {
+        // Keep the selected item on the same row of the screen if possible
+        const auto selected_row = this->selected_item_idx - this->advanced_item_count;
+        const auto total_item_count = this->GetTotalItemCount();
+        const auto changed_selection = new_selected_idx != this->selected_item_idx;
+        this->selected_item_idx = (new_selected_idx < total_item_count) ? new_selected_idx : 0;
+        this->advanced_item_count = (this->selected_item_idx > selected_row) ? (this->selected_item_idx - selected_row) : 0;
+        if((this->advanced_item_count + this->items_to_show) > total_item_count) {
+            this->advanced_item_count = (total_item_count > this->items_to_show) ? (total_item_count - this->items_to_show) : 0;
+        }
+
+        // Items streamed in every frame shouldn't interrupt the focus animation
+        this->InvalidateLoadedRows();
+        if(changed_selection) {
+            this->prev_selected_item_idx = this->selected_item_idx;
+            this->selected_item_alpha = 0xFF;
+            this->prev_selected_item_alpha = 0;
+            this->HandleOnSelectionChanged();
         }
     }
 
+    void Menu::SetDataSource(std::shared_ptr<MenuDataSource> data_src) {
+        if(data_src != nullptr) {
+            this->data_src = data_src;
+        }
+        else {
+            this->data_src = this->item_src;
+        }
+        this->uses_item_src = this->data_src == this->item_src;
+
+        this->selected_item_idx = 0;
+        this->prev_selected_item_idx = 0;
+        this->advanced_item_count = 0;
+        this->ForceReloadItems();
+    }
+
     void Menu::MoveUp() {
+        this->last_moved_up = true;
         if(this->selected_item_idx > 0) {
             if(this->selected_item_idx == this->advanced_item_count) {
                 this->advanced_item_count--;
                 this->selected_item_idx--;
                 this->HandleOnSelectionChanged();
-                this->ReloadItemRenders();
             }
             else {
                 this->prev_selected_item_idx = this->selected_item_idx;
@@ -46,22 +256,23 @@ namespace pu::ui::elm {
             }
         }
         else {
-            this->selected_item_idx = this->items.size() - 1;
+            const auto total_item_count = this->GetTotalItemCount();
+            this->selected_item_idx = total_item_count - 1;
             this->advanced_item_count = 0;
-            if(this->items.size() >= this->items_to_show) {
-                this->advanced_item_count = this->items.size() - this->items_to_show;
-                this->ReloadItemRenders();
+            if(total_item_count >= this->items_to_show) {
+                this->advanced_item_count = total_item_count - this->items_to_show;
             }
         }
     }
 
     void Menu::MoveDown() {
-        if(!this->items.empty() && (this->selected_item_idx < (this->items.size() - 1))) {
+        this->last_moved_up = false;
+        const auto total_item_count = this->GetTotalItemCount();
+        if((total_item_count > 0) && (this->selected_item_idx < (total_item_count - 1))) {
             if((this->selected_item_idx - this->advanced_item_count) == (this->items_to_show - 1)) {
                 this->advanced_item_count++;
                 this->selected_item_idx++;
                 this->HandleOnSelectionChanged();
-                this->ReloadItemRenders();
             }
             else {
                 this->prev_selected_item_idx = this->selected_item_idx;
@@ -77,9 +288,6 @@ namespace pu::ui::elm {
         else {
             this->selected_item_idx = 0;
             this->advanced_item_count = 0;
-            if(this->items.size() >= this->items_to_show) {
-                this->ReloadItemRenders();
-            }
         }
     }
 
@@ -99,6 +307,12 @@ namespace pu::ui::elm {
         this->prev_selected_item_alpha = 0;
         this->prev_selected_item_alpha_incr = {};
         this->on_selection_changed_cb = {};
+        this->item_src = MenuItemDataSource::New();
+        this->data_src = this->item_src;
+        this->uses_item_src = true;
+        this->loaded_rows_start = 0;
+        this->prefetch_item_count = DefaultPrefetchItemCount;
+        this->last_moved_up = false;
         this->cooldown_enabled = false;
         this->item_touched = false;
         this->items_focus_clr = items_focus_clr;
@@ -116,12 +330,12 @@ namespace pu::ui::elm {
     }
 
     void Menu::ClearItems() {
-        this->items.clear();
-
-        for(auto &name_tex : this->loaded_name_texs) {
-            render::DeleteTexture(name_tex);
+        if(!this->uses_item_src) {
+            return;
         }
-        this->loaded_name_texs.clear();
+
+        this->item_src->ClearItems();
+        this->loaded_rows.clear();
 
         this->selected_item_idx = 0;
         this->prev_selected_item_idx = 0;
@@ -129,11 +343,12 @@ namespace pu::ui::elm {
     }
 
     void Menu::SetSelectedIndex(const u32 idx) {
-        if(idx < this->items.size()) {
+        const auto total_item_count = this->GetTotalItemCount();
+        if(idx < total_item_count) {
             this->selected_item_idx = idx;
             this->advanced_item_count = 0;
-            if(this->selected_item_idx >= (this->items.size() - this->items_to_show)) {
-                this->advanced_item_count = this->items.size() - this->items_to_show;
+            if(this->selected_item_idx >= (total_item_count - this->items_to_show)) {
+                this->advanced_item_count = total_item_count - this->items_to_show;
             }
             else if(this->selected_item_idx < this->items_to_show) {
                 this->advanced_item_count = 0;
@@ -142,24 +357,28 @@ namespace pu::ui::elm {
                 this->advanced_item_count = this->selected_item_idx;
             }
 
-            this->ReloadItemRenders();
             this->selected_item_alpha = 0xFF;
             this->prev_selected_item_alpha = 0;
         }
     }
 
     void Menu::OnRender(render::Renderer::Ref &drawer, const i32 x, const i32 y) {
-        if(!this->items.empty()) {
+        auto new_selected_idx = this->selected_item_idx;
+        if(this->data_src->PollChanges(new_selected_idx)) {
+            this->ApplyItemChanges(new_selected_idx);
+        }
+
+        const auto total_item_count = this->GetTotalItemCount();
+        if(total_item_count > 0) {
             const auto item_count = this->GetItemCount();
 
-            if(this->loaded_name_texs.empty()) {
-                this->ReloadItemRenders();
-            }
+            this->UpdateLoadedRows();
+            this->RequestRowRenders();
 
             auto cur_item_y = y;
             for(u32 i = this->advanced_item_count; i < (this->advanced_item_count + item_count); i++) {
-                const auto loaded_tex_idx = i - this->advanced_item_count;
-                auto name_tex = this->loaded_name_texs.at(loaded_tex_idx);
+                const auto &row = this->loaded_rows.at(i - this->loaded_rows_start);
+                auto name_tex = row.name_tex->Get();
                 if(this->selected_item_idx == i) {
                     drawer->RenderRectangleFill(this->items_clr, x, cur_item_y, this->w, this->items_h);
                     if(this->selected_item_alpha < 0xFF) {
@@ -186,13 +405,12 @@ namespace pu::ui::elm {
                     drawer->RenderRectangleFill(this->items_clr, x, cur_item_y, this->w, this->items_h);
                 }
 
-                auto &item = this->items.at(i);
                 const auto name_height = render::GetTextureHeight(name_tex);
                 auto name_x = x + this->text_margin;
                 const auto name_y = cur_item_y + ((this->items_h - name_height) / 2);
-                if(item->HasIcon()) {
-                    auto icon_tex = this->items.at(i)->GetIconTexture();
-                    const auto factor = (float)render::GetTextureHeight(icon_tex->Get()) / (float)render::GetTextureWidth(icon_tex->Get());
+                if(row.icon != nullptr) {
+                    auto icon_tex = row.icon;
+                    const auto factor = (float)icon_tex->GetHeight() / (float)icon_tex->GetWidth();
                     auto icon_width = (i32)(this->items_h * this->icon_item_sizes_factor);
                     auto icon_height = icon_width;
                     if(factor < 1) {
@@ -205,21 +423,21 @@ namespace pu::ui::elm {
                     const auto icon_x = x + this->icon_margin;
                     const auto icon_y = cur_item_y + (this->items_h - icon_height) / 2;
                     name_x = icon_x + icon_width + this->text_margin;
-                    drawer->RenderTexture(icon_tex->Get(), icon_x, icon_y, render::TextureRenderOptions::WithCustomDimensions(icon_width, icon_height));
+                    drawer->RenderTexture(icon_tex, icon_x, icon_y, render::TextureRenderOptions::WithCustomDimensions(icon_width, icon_height));
                 }
                 drawer->RenderTexture(name_tex, name_x, name_y);
                 cur_item_y += this->items_h;
             }
 
-            if(this->items_to_show < this->items.size()) {
+            if(this->items_to_show < total_item_count) {
                 const auto scrollbar_x = x + (this->w - this->scrollbar_width);
                 const auto scrollbar_height = this->GetHeight();
                 drawer->RenderRectangleFill(this->scrollbar_clr, scrollbar_x, y, this->scrollbar_width, scrollbar_height);
 
                 const auto light_scrollbar_clr = this->MakeLighterScrollbarColor();
-                const auto scrollbar_factor = (double)this->items_to_show / (double)this->items.size();
+                const auto scrollbar_factor = (double)this->items_to_show / (double)total_item_count;
                 const auto scrollbar_front_height = (u32)(scrollbar_height * scrollbar_factor);
-                const auto scrollbar_front_y = y + (u32)(this->advanced_item_count * ((double)scrollbar_height / (double)this->items.size()));
+                const auto scrollbar_front_y = y + (u32)(this->advanced_item_count * ((double)scrollbar_height / (double)total_item_count));
                 drawer->RenderRectangleFill(light_scrollbar_clr, scrollbar_x, scrollbar_front_y, this->scrollbar_width, scrollbar_front_height);
             }
             drawer->RenderShadowSimple(x, cur_item_y, this->w, this->shadow_height, this->shadow_base_alpha);
@@ -227,7 +445,7 @@ namespace pu::ui::elm {
     }
 
     void Menu::OnInput(const u64 keys_down, const u64 keys_up, const u64 keys_held, const TouchPoint touch_pos) {
-        if(this->items.empty()) {
+        if(this->GetTotalItemCount() == 0) {
             return;
         }
 
@@ -0,0 +1,370 @@
+#include <pu/ui/elm/elm_MenuFilter.hpp>
+#include <algorithm>
+
+namespace pu::ui::elm {
+
+    namespace {
+
+        // Only ASCII letters are folded, other bytes (like UTF-8 sequences) are compared as they are
+        std::string FoldCase(const std::string &str) {
+            auto folded = str;
+            for(auto &ch : folded) {
+                if((ch >= 'A') && (ch <= 'Z')) {
+                    ch = ch - 'A' + 'a';
+                }
+            }
+            return folded;
+        }
+
+        inline u32 MakeNgramKey(const std::string &str, const size_t offset) {
+            return (static_cast<u8>(str[offset]) << 16) | (static_cast<u8>(str[offset + 1]) << 8) | static_cast<u8>(str[offset + 2]);
+        }
+
+        static_assert(MenuFilter::NgramLength == 3, "Ngram keys are made of three bytes");
+
+        // Items processed between checks of the cancellation token, which is cheap but not free
+        constexpr u32 CancelCheckItemCount = 0x100;
+
+        inline bool IsCancelledAt(const jobs::CancellationToken &token, const u32 i) {
+            return ((i % CancelCheckItemCount) == 0) && token.IsCancelled();
+        }
+
+    }
+
+    MenuFilter::MenuFilter(std::shared_ptr<MenuDataSource> base_src) : base_src(base_src), job_token(), job(), job_scheduled(false), has_request(false), req_names_set(false), has_result(false), last_matches_valid(false), view_changed(false), indexed_count(0) {
+        mutexInit(&this->lock);
+
+        // Everything is shown until the index is ready
+        this->view.resize(this->base_src->GetItemCount());
+        for(u32 i = 0; i < this->view.size(); i++) {
+            this->view.at(i) = i;
+        }
+
+        this->Reindex();
+    }
+
+    MenuFilter::~MenuFilter() {
+        // A queued job is dropped, and a running one stops partway through the request it's processing
+        this->job_token.Cancel();
+        this->job.Wait();
+    }
+
+    void MenuFilter::ProcessRequests(const jobs::CancellationToken &token) {
+        while(true) {
+            mutexLock(&this->lock);
+            if(!this->has_request || token.IsCancelled()) {
+                this->job_scheduled = false;
+                mutexUnlock(&this->lock);
+                break;
+            }
+
+            // Requests made meanwhile are merged, only the latest query and sort keys matter
+            auto names = std::move(this->req_names);
+            auto sort_values = std::move(this->req_sort_values);
+            const auto names_set = this->req_names_set;
+            const auto query = this->req_query;
+            const auto sort_keys = this->req_sort_keys;
+            this->req_names.clear();
+            this->req_sort_values.clear();
+            this->req_names_set = false;
+            this->has_request = false;
+            mutexUnlock(&this->lock);
+
+            this->ProcessRequest(names, sort_values, names_set, query, sort_keys, token);
+        }
+    }
+
+    void MenuFilter::ProcessRequest(std::vector<std::string> &names, std::vector<s64> &sort_values, const bool names_set, const std::string &query, const std::vector<SortKey> &sort_keys, const jobs::CancellationToken &token) {
+        if(names_set) {
+            this->ClearIndex();
+        }
+        if(!names.empty() && !this->IndexItems(names, sort_values, token)) {
+            return;
+        }
+
+        std::vector<u32> matches;
+        if(!this->FindMatches(FoldCase(query), token, matches)) {
+            return;
+        }
+        // Keys are always sent along with the values read for them, so there's one value per key for every item
+        const auto key_count = sort_keys.size();
+        if((key_count > 0) && (this->sort_values.size() == (this->folded_names.size() * key_count))) {
+            std::stable_sort(matches.begin(), matches.end(), [&](const u32 idx_a, const u32 idx_b) {
+                for(size_t i = 0; i < key_count; i++) {
+                    const auto &sort_key = sort_keys.at(i);
+                    i32 cmp = 0;
+                    if(sort_key.get_value) {
+                        const auto value_a = this->sort_values.at(idx_a * key_count + i);
+                        const auto value_b = this->sort_values.at(idx_b * key_count + i);
+                        cmp = (value_a < value_b) ? -1 : ((value_a > value_b) ? 1 : 0);
+                    }
+                    else {
+                        cmp = this->folded_names.at(idx_a).compare(this->folded_names.at(idx_b));
+                    }
+                    if(cmp != 0) {
+                        return sort_key.descending ? (cmp > 0) : (cmp < 0);
+                    }
+                }
+                return false;
+            });
+        }
+
+        mutexLock(&this->lock);
+        // Results already outdated by a newer request are never shown
+        if(!this->has_request) {
+            this->result_view = std::move(matches);
+            this->has_result = true;
+        }
+        mutexUnlock(&this->lock);
+    }
+
+    void MenuFilter::ClearIndex() {
+        this->folded_names.clear();
+        this->sort_values.clear();
+        this->ngram_index.clear();
+        this->last_query.clear();
+        this->last_matches.clear();
+        this->last_matches_valid = false;
+    }
+
+    bool MenuFilter::IndexItems(std::vector<std::string> &names, std::vector<s64> &sort_values, const jobs::CancellationToken &token) {
+        const auto start_idx = static_cast<u32>(this->folded_names.size());
+        this->sort_values.insert(this->sort_values.end(), sort_values.begin(), sort_values.end());
+        this->folded_names.reserve(start_idx + names.size());
+        // New items may match even if they aren't among the matches of the last query
+        this->last_matches_valid = false;
+        for(u32 i = 0; i < names.size(); i++) {
+            if(IsCancelledAt(token, i)) {
+                return false;
+            }
+
+            const auto idx = start_idx + i;
+            auto folded_name = FoldCase(names.at(i));
+            for(size_t j = 0; (j + NgramLength) <= folded_name.length(); j++) {
+                // Items are indexed in order, so each list stays sorted and checking the last entry avoids duplicates
+                auto &item_list = this->ngram_index[MakeNgramKey(folded_name, j)];
+                if(item_list.empty() || (item_list.back() != idx)) {
+                    item_list.push_back(idx);
+                }
+            }
+            this->folded_names.push_back(std::move(folded_name));
+        }
+        return true;
+    }
+
+    bool MenuFilter::FindMatches(const std::string &folded_query, const jobs::CancellationToken &token, std::vector<u32> &out_matches) {
+        std::vector<u32> candidates;
+        // Narrowing from short (or empty) queries would skip the index, which rules out way more items
+        if(this->last_matches_valid && (this->last_query.length() >= NgramLength) && (folded_query.find(this->last_query) != std::string::npos)) {
+            // The query grew: only the previous matches may still match
+            candidates = this->last_matches;
+        }
+        else if(folded_query.length() >= NgramLength) {
+            // Only items containing every ngram of the query may match, intersecting the shortest lists first
+            std::vector<const std::vector<u32>*> item_lists;
+            for(size_t i = 0; (i + NgramLength) <= folded_query.length(); i++) {
+                auto it = this->ngram_index.find(MakeNgramKey(folded_query, i));
+                if(it == this->ngram_index.end()) {
+                    item_lists.clear();
+                    break;
+                }
+                item_lists.push_back(&it->second);
+            }
+
+            if(!item_lists.empty()) {
+                std::sort(item_lists.begin(), item_lists.end(), [](const std::vector<u32> *list_a, const std::vector<u32> *list_b) {
+                    return list_a->size() < list_b->size();
+                });
+                candidates = *item_lists.front();
+                for(size_t i = 1; (i < item_lists.size()) && !candidates.empty(); i++) {
+                    std::vector<u32> intersection;
+                    std::set_intersection(candidates.begin(), candidates.end(), item_lists.at(i)->begin(), item_lists.at(i)->end(), std::back_inserter(intersection));
+                    candidates = std::move(intersection);
+                }
+            }
+        }
+        else {
+            candidates.resize(this->folded_names.size());
+            for(u32 i = 0; i < candidates.size(); i++) {
+                candidates.at(i) = i;
+            }
+        }
+
+        // Candidates still need to contain the whole query
+        std::vector<u32> matches;
+        matches.reserve(candidates.size());
+        for(u32 i = 0; i < candidates.size(); i++) {
+            if(IsCancelledAt(token, i)) {
+                return false;
+            }
+
+            const auto idx = candidates.at(i);
+            if(this->folded_names.at(idx).find(folded_query) != std::string::npos) {
+                matches.push_back(idx);
+            }
+        }
+
+        this->last_query = folded_query;
+        this->last_matches = matches;
+        this->last_matches_valid = true;
+        out_matches = std::move(matches);
+        return true;
+    }
+
+    bool MenuFilter::PostRequest() {
+        // Called with the lock held, returns whether a job needs to be submitted (once the lock is released)
+        this->has_request = true;
+        const auto needs_job = !this->job_scheduled;
+        this->job_scheduled = true;
+        return needs_job;
+    }
+
+    void MenuFilter::SubmitJob() {
+        this->job = jobs::Submit([this, token = this->job_token]() {
+            this->ProcessRequests(token);
+        }, {}, jobs::JobPriority::Normal, this->job_token);
+    }
+
+    void MenuFilter::CopyItems(const u32 start_idx, const u32 end_idx, std::vector<std::string> &out_names, std::vector<s64> &out_sort_values) {
+        out_names.reserve(end_idx - start_idx);
+        out_sort_values.reserve((end_idx - start_idx) * this->sort_keys.size());
+        for(u32 i = start_idx; i < end_idx; i++) {
+            out_names.push_back(this->base_src->GetItemName(i));
+            for(const auto &sort_key : this->sort_keys) {
+                // Name keys use the names themselves, but still take a slot so every item has as many values as keys
+                out_sort_values.push_back(sort_key.get_value ? sort_key.get_value(i) : 0);
+            }
+        }
+    }
+
+    void MenuFilter::AppendItems(const u32 item_count) {
+        std::vector<std::string> names;
+        std::vector<s64> sort_values;
+        this->CopyItems(this->indexed_count, item_count, names, sort_values);
+
+        // Also appended to items not indexed yet, whether those replace the indexed ones or not
+        mutexLock(&this->lock);
+        this->req_names.insert(this->req_names.end(), std::make_move_iterator(names.begin()), std::make_move_iterator(names.end()));
+        this->req_sort_values.insert(this->req_sort_values.end(), sort_values.begin(), sort_values.end());
+        const auto shows_all = this->req_query.empty() && this->sort_keys.empty();
+        if(shows_all) {
+            // It would hide the items shown below until the next one arrives
+            this->result_view.clear();
+            this->has_result = false;
+        }
+        const auto needs_job = this->PostRequest();
+        mutexUnlock(&this->lock);
+        if(needs_job) {
+            this->SubmitJob();
+        }
+
+        // Nothing is filtered or sorted, so new items can be shown before they're indexed
+        if(shows_all) {
+            for(u32 i = this->indexed_count; i < item_count; i++) {
+                this->view.push_back(i);
+            }
+            this->view_changed = true;
+        }
+        this->indexed_count = item_count;
+    }
+
+    void MenuFilter::Reindex() {
+        std::vector<std::string> names;
+        std::vector<s64> sort_values;
+        const auto item_count = this->base_src->GetItemCount();
+        this->CopyItems(0, item_count, names, sort_values);
+        this->indexed_count = item_count;
+
+        // Items past the new count are dropped right away, since the base can't be asked about them until the new results arrive
+        const auto prev_view_size = this->view.size();
+        this->view.erase(std::remove_if(this->view.begin(), this->view.end(), [item_count](const u32 idx) {
+            return idx >= item_count;
+        }), this->view.end());
+        if(this->view.size() != prev_view_size) {
+            this->view_changed = true;
+        }
+
+        mutexLock(&this->lock);
+        // A result not taken yet was made for the previous items, which may no longer exist
+        this->result_view.clear();
+        this->has_result = false;
+        this->req_names = std::move(names);
+        this->req_sort_values = std::move(sort_values);
+        this->req_sort_keys = this->sort_keys;
+        this->req_names_set = true;
+        const auto needs_job = this->PostRequest();
+        mutexUnlock(&this->lock);
+        if(needs_job) {
+            this->SubmitJob();
+        }
+    }
+
+    void MenuFilter::SetQuery(const std::string &query) {
+        mutexLock(&this->lock);
+        this->req_query = query;
+        const auto needs_job = this->PostRequest();
+        mutexUnlock(&this->lock);
+        if(needs_job) {
+            this->SubmitJob();
+        }
+    }
+
+    void MenuFilter::SetSortKeys(const std::vector<SortKey> &sort_keys) {
+        // The keys are sent along with their values, so that the job never sorts with values read for other keys
+        this->sort_keys = sort_keys;
+        this->Reindex();
+    }
+
+    bool MenuFilter::PollChanges(u32 &selected_idx) {
+        auto changed = false;
+        mutexLock(&this->lock);
+        if(this->has_result) {
+            auto new_view = std::move(this->result_view);
+            this->result_view.clear();
+            this->has_result = false;
+            mutexUnlock(&this->lock);
+
+            u32 new_selected_idx = 0;
+            if(selected_idx < this->view.size()) {
+                const auto selected_base_idx = this->view.at(selected_idx);
+                auto it = std::find(new_view.begin(), new_view.end(), selected_base_idx);
+                if(it != new_view.end()) {
+                    new_selected_idx = static_cast<u32>(it - new_view.begin());
+                }
+            }
+
+            this->view = std::move(new_view);
+            this->view_changed = false;
+            selected_idx = new_selected_idx;
+            changed = true;
+        }
+        else {
+            mutexUnlock(&this->lock);
+        }
+
+        // The menu only polls the filter, so changes of the base (like pushed item batches) need to be polled from here
+        // Done after taking results, so that items shown right away stay there until results including them arrive
+        // The selection is kept through the view instead, since it maps the base's items
+        u32 base_selected_idx = (selected_idx < this->view.size()) ? this->view.at(selected_idx) : 0;
+        if(this->base_src->PollChanges(base_selected_idx)) {
+            const auto item_count = this->base_src->GetItemCount();
+            if(item_count >= this->indexed_count) {
+                this->AppendItems(item_count);
+            }
+            else {
+                this->Reindex();
+            }
+        }
+
+        // Only the count changed, but the menu still needs to keep its selection in range
+        if(this->view_changed) {
+            this->view_changed = false;
+            if(selected_idx >= this->view.size()) {
+                selected_idx = this->view.empty() ? 0 : (this->view.size() - 1);
+            }
+            changed = true;
+        }
+        return changed;
+    }
+
+}
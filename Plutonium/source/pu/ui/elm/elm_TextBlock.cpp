@@ -3,44 +3,78 @@
 namespace pu::ui::elm {
 
     TextBlock::TextBlock(const i32 x, const i32 y, const std::string &text) : Element() {
+        rmutexInit(&this->lock);
         this->x = x;
         this->y = y;
         this->clr = DefaultColor;
-        this->text_tex = nullptr;
         this->fnt_name = GetDefaultFont(DefaultFontSize::MediumLarge);
+        this->wrap_width = 0;
+        this->text_w = 0;
+        this->text_h = 0;
         this->SetText(text);
     }
 
-    TextBlock::~TextBlock() {
-        render::DeleteTexture(this->text_tex);
+    TextBlock::~TextBlock() {}
+
+    void TextBlock::RequestText() {
+        if(!render::GetWrappedTextDimensions(this->fnt_name, this->text, this->wrap_width, this->text_w, this->text_h)) {
+            this->text_w = 0;
+            this->text_h = 0;
+        }
+        this->text_tex.Request(this->fnt_name, this->text, this->clr, 0, 0, this->wrap_width);
     }
 
     i32 TextBlock::GetWidth() {
-        return render::GetTextureWidth(this->text_tex);
+        rmutexLock(&this->lock);
+        const auto text_w = this->text_w;
+        rmutexUnlock(&this->lock);
+        return text_w;
     }
 
     i32 TextBlock::GetHeight() {
-        return render::GetTextureHeight(this->text_tex);
+        rmutexLock(&this->lock);
+        const auto text_h = this->text_h;
+        rmutexUnlock(&this->lock);
+        return text_h;
+    }
+
+    std::string TextBlock::GetText() {
+        rmutexLock(&this->lock);
+        const auto text = this->text;
+        rmutexUnlock(&this->lock);
+        return text;
     }
 
     void TextBlock::SetText(const std::string &text) {
+        rmutexLock(&this->lock);
         this->text = text;
-        render::DeleteTexture(this->text_tex);
-        this->text_tex = render::RenderText(this->fnt_name, text, this->clr);
+        this->RequestText();
+        rmutexUnlock(&this->lock);
     }
 
     void TextBlock::SetFont(const std::string &font_name) {
+        rmutexLock(&this->lock);
         this->fnt_name = font_name;
-        this->SetText(this->text);
+        this->RequestText();
+        rmutexUnlock(&this->lock);
+    }
+
+    void TextBlock::SetWrapWidth(const u32 wrap_width) {
+        rmutexLock(&this->lock);
+        this->wrap_width = wrap_width;
+        this->RequestText();
+        rmutexUnlock(&this->lock);
     }
 
     void TextBlock::SetColor(const Color clr) {
+        rmutexLock(&this->lock);
         this->clr = clr;
-        this->SetText(this->text);
+        this->RequestText();
+        rmutexUnlock(&this->lock);
     }
 
     void TextBlock::OnRender(render::Renderer::Ref &drawer, const i32 x, const i32 y) {
-        drawer->RenderTexture(this->text_tex, x, y);
+        drawer->RenderTexture(this->text_tex.Get(), x, y);
     }
 
 }
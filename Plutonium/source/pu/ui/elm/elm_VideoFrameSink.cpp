@@ -0,0 +1,158 @@
+#include <pu/ui/elm/elm_VideoFrameSink.hpp>
+#include <cstring>
+
+namespace pu::ui::elm {
+
+    VideoFrameSink::VideoFrameSink(const i32 x, const i32 y, const u32 frame_width, const u32 frame_height, const VideoFrameFormat fmt) : Element(), buf_exchange(), pushed_count(0), shown_count(0), dropped_count(0), late_count(0) {
+        this->x = x;
+        this->y = y;
+        this->rend_opts = render::TextureRenderOptions::WithCustomDimensions(frame_width, frame_height);
+        this->frame_width = frame_width;
+        this->frame_height = frame_height;
+        this->fmt = fmt;
+        mutexInit(&this->producer_lock);
+        this->tex = nullptr;
+        this->has_frame = false;
+        this->late_threshold_us = DefaultLateThresholdUs;
+
+        // Planes are stored one after the other with no padding
+        size_t frame_size = 0;
+        switch(this->fmt) {
+            case VideoFrameFormat::RGBA: {
+                frame_size = this->frame_width * this->frame_height * 4;
+                break;
+            }
+            case VideoFrameFormat::I420:
+            case VideoFrameFormat::NV12: {
+                frame_size = this->frame_width * this->frame_height + 2 * this->GetChromaWidth() * this->GetChromaHeight();
+                break;
+            }
+        }
+        for(auto &frame_buf : this->frame_bufs) {
+            frame_buf.data.resize(frame_size);
+        }
+    }
+
+    VideoFrameSink::~VideoFrameSink() {
+        render::DeleteTexture(this->tex);
+    }
+
+    void VideoFrameSink::CopyPlane(u8 *dst, const u8 *src, const i32 src_pitch, const u32 row_size, const u32 row_count) {
+        if(static_cast<u32>(src_pitch) == row_size) {
+            std::memcpy(dst, src, row_size * row_count);
+        }
+        else {
+            for(u32 i = 0; i < row_count; i++) {
+                std::memcpy(dst + i * row_size, src + i * src_pitch, row_size);
+            }
+        }
+    }
+
+    void VideoFrameSink::UploadFrame(const FrameBuffer &frame_buf) {
+        const auto luma_size = this->frame_width * this->frame_height;
+        const auto chroma_size = this->GetChromaWidth() * this->GetChromaHeight();
+        const auto data = frame_buf.data.data();
+        switch(this->fmt) {
+            case VideoFrameFormat::RGBA: {
+                SDL_UpdateTexture(this->tex, nullptr, data, this->frame_width * 4);
+                break;
+            }
+            case VideoFrameFormat::I420: {
+                SDL_UpdateYUVTexture(this->tex, nullptr, data, this->frame_width, data + luma_size, this->GetChromaWidth(), data + luma_size + chroma_size, this->GetChromaWidth());
+                break;
+            }
+            case VideoFrameFormat::NV12: {
+                SDL_UpdateNVTexture(this->tex, nullptr, data, this->frame_width, data + luma_size, this->GetChromaWidth() * 2);
+                break;
+            }
+        }
+    }
+
+    void VideoFrameSink::PushFrame(const VideoFrame &frame) {
+        mutexLock(&this->producer_lock);
+        auto &frame_buf = this->frame_bufs.at(this->buf_exchange.GetWriteIndex());
+        auto data = frame_buf.data.data();
+        const auto luma_size = this->frame_width * this->frame_height;
+        switch(this->fmt) {
+            case VideoFrameFormat::RGBA: {
+                this->CopyPlane(data, frame.planes.at(0), frame.pitches.at(0), this->frame_width * 4, this->frame_height);
+                break;
+            }
+            case VideoFrameFormat::I420: {
+                const auto chroma_size = this->GetChromaWidth() * this->GetChromaHeight();
+                this->CopyPlane(data, frame.planes.at(0), frame.pitches.at(0), this->frame_width, this->frame_height);
+                this->CopyPlane(data + luma_size, frame.planes.at(1), frame.pitches.at(1), this->GetChromaWidth(), this->GetChromaHeight());
+                this->CopyPlane(data + luma_size + chroma_size, frame.planes.at(2), frame.pitches.at(2), this->GetChromaWidth(), this->GetChromaHeight());
+                break;
+            }
+            case VideoFrameFormat::NV12: {
+                this->CopyPlane(data, frame.planes.at(0), frame.pitches.at(0), this->frame_width, this->frame_height);
+                this->CopyPlane(data + luma_size, frame.planes.at(1), frame.pitches.at(1), this->GetChromaWidth() * 2, this->GetChromaHeight());
+                break;
+            }
+        }
+        frame_buf.push_time = std::chrono::steady_clock::now();
+
+        const auto dropped = this->buf_exchange.Publish();
+        mutexUnlock(&this->producer_lock);
+
+        this->pushed_count++;
+        if(dropped) {
+            this->dropped_count++;
+        }
+    }
+
+    VideoFrameStatistics VideoFrameSink::GetStatistics() {
+        return { this->pushed_count.load(), this->shown_count.load(), this->dropped_count.load(), this->late_count.load() };
+    }
+
+    void VideoFrameSink::ResetStatistics() {
+        this->pushed_count = 0;
+        this->shown_count = 0;
+        this->dropped_count = 0;
+        this->late_count = 0;
+    }
+
+    void VideoFrameSink::OnRender(render::Renderer::Ref &drawer, const i32 x, const i32 y) {
+        if(this->tex == nullptr) {
+            u32 tex_fmt = SDL_PIXELFORMAT_RGBA32;
+            switch(this->fmt) {
+                case VideoFrameFormat::RGBA: {
+                    tex_fmt = SDL_PIXELFORMAT_RGBA32;
+                    break;
+                }
+                case VideoFrameFormat::I420: {
+                    tex_fmt = SDL_PIXELFORMAT_IYUV;
+                    break;
+                }
+                case VideoFrameFormat::NV12: {
+                    tex_fmt = SDL_PIXELFORMAT_NV12;
+                    break;
+                }
+            }
+            this->tex = SDL_CreateTexture(render::GetMainRenderer(), tex_fmt, SDL_TEXTUREACCESS_STREAMING, this->frame_width, this->frame_height);
+            if(this->tex == nullptr) {
+                return;
+            }
+            render::TrackTexture(this->tex, "VideoFrameSink");
+        }
+
+        // Only the latest frame is uploaded, at most once per render
+        if(this->buf_exchange.Acquire()) {
+            const auto &frame_buf = this->frame_bufs.at(this->buf_exchange.GetReadIndex());
+            this->UploadFrame(frame_buf);
+            this->has_frame = true;
+
+            this->shown_count++;
+            const auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - frame_buf.push_time).count();
+            if(latency_us > this->late_threshold_us) {
+                this->late_count++;
+            }
+        }
+
+        if(this->has_frame) {
+            drawer->RenderTexture(this->tex, x, y, this->rend_opts);
+        }
+    }
+
+}
@@ -1,4 +1,6 @@
 #include <pu/ui/render/render_Renderer.hpp>
+#include <pu/audio/audio_Latency.hpp>
+#include <list>
 
 namespace pu::ui::render {
 
@@ -9,9 +11,20 @@ sdl2::Renderer g_Renderer = nullptr;
 sdl2::Window g_Window = nullptr;
 sdl2::Surface g_WindowSurface = nullptr;
 
-// Global font object
+// Global font object, guarded since fonts are also looked up from text render workers
+RMutex g_FontTableLock = {};
 std::vector<std::pair<std::string, std::shared_ptr<ttf::Font>>> g_FontTable;
 
+// Font families, whose fonts are only created once each size is used, most recently used first
+std::vector<std::pair<std::string, FontFamilyLoadFunction>> g_FontFamilyTable;
+std::list<std::pair<std::string, std::shared_ptr<ttf::Font>>> g_FamilyFontList;
+u32 g_MaxFamilyFontCount = 0;
+
+// Text without a wrap width wraps at the window's width, kept here since text may be rasterized on job workers
+u32 g_DefaultWrapWidth = ScreenWidth;
+
+constexpr char FontNameSizeSeparator = '@';
+
 inline bool ExistsFont(const std::string& font_name) {
     for (const auto& [name, font] : g_FontTable) {
         if (name == font_name) {
@@ -22,6 +35,87 @@ inline bool ExistsFont(const std::string& font_name) {
     return false;
 }
 
+// Default font sizes loaded so far, without creating any others
+std::vector<std::shared_ptr<ttf::Font>> GetLoadedDefaultFonts() {
+    const auto family_prefix = std::string(DefaultFontFamily) + FontNameSizeSeparator;
+    std::vector<std::shared_ptr<ttf::Font>> fonts;
+    rmutexLock(&g_FontTableLock);
+    for (const auto& [name, font] : g_FontTable) {
+        if (name.compare(0, family_prefix.length(), family_prefix) == 0) {
+            fonts.push_back(font);
+        }
+    }
+    for (const auto& [name, font] : g_FamilyFontList) {
+        if (name.compare(0, family_prefix.length(), family_prefix) == 0) {
+            fonts.push_back(font);
+        }
+    }
+    rmutexUnlock(&g_FontTableLock);
+    return fonts;
+}
+
+constexpr char TruncatedTextSuffix[] = "...";
+
+inline bool FitsMaxDimensions(const std::pair<u32, u32> dims, const u32 max_width, const u32 max_height) {
+    if ((max_width > 0) && (dims.first <= max_width)) {
+        return true;
+    }
+    if ((max_height > 0) && (dims.second <= max_height)) {
+        return true;
+    }
+    return false;
+}
+
+inline bool IsUtf8CodepointStart(const char ch) {
+    return (static_cast<u8>(ch) & 0xC0) != 0x80;
+}
+
+std::shared_ptr<ttf::Font> FindFontImpl(const std::string& font_name) {
+    for (auto& [name, font] : g_FontTable) {
+        if (name == font_name) {
+            return font;
+        }
+    }
+
+    for (auto it = g_FamilyFontList.begin(); it != g_FamilyFontList.end(); it++) {
+        if (it->first == font_name) {
+            g_FamilyFontList.splice(g_FamilyFontList.begin(), g_FamilyFontList, it);
+            return it->second;
+        }
+    }
+
+    // Not loaded (or already closed), create it if it's a size of a known family
+    const auto sep_pos = font_name.rfind(FontNameSizeSeparator);
+    if (sep_pos == std::string::npos) {
+        return nullptr;
+    }
+
+    const auto font_size = static_cast<u32>(strtoul(font_name.c_str() + sep_pos + 1, nullptr, 10));
+    if (font_size == 0) {
+        return nullptr;
+    }
+
+    for (const auto& [name, load_fn] : g_FontFamilyTable) {
+        if (font_name.compare(0, sep_pos, name) == 0 && (name.length() == sep_pos)) {
+            auto font = std::make_shared<ttf::Font>(font_size);
+            if (!load_fn(font)) {
+                return nullptr;
+            }
+
+            g_FamilyFontList.push_front(std::make_pair(font_name, font));
+            if (g_MaxFamilyFontCount > 0) {
+                // Closing the coldest fonts also frees their glyph caches
+                while (g_FamilyFontList.size() > g_MaxFamilyFontCount) {
+                    g_FamilyFontList.pop_back();
+                }
+            }
+            return font;
+        }
+    }
+
+    return nullptr;
+}
+
 }  // namespace
 
 void Renderer::Initialize() {
@@ -46,38 +140,66 @@ void Renderer::Initialize() {
         g_Window = SDL_CreateWindow("Plutonium-SDL2", 0, 0, this->init_opts.width, this->init_opts.height, 0);
         g_Renderer = SDL_CreateRenderer(g_Window, -1, this->init_opts.sdl_render_flags);
         g_WindowSurface = SDL_GetWindowSurface(g_Window);
+        g_DefaultWrapWidth = this->init_opts.width;
         SDL_SetRenderDrawBlendMode(g_Renderer, SDL_BLENDMODE_BLEND);
         SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "2");
+        SetPremultipliedAlphaEnabled(this->init_opts.premultiply_alpha);
 
         if (this->init_opts.init_img) {
             IMG_Init(this->init_opts.sdl_img_flags);
         }
 
+        // All background work shares the job system, sized for whichever feature asks for the most workers
+        auto job_worker_count = std::max(this->init_opts.job_worker_count, this->init_opts.text_render_worker_count);
+        if (!this->init_opts.glyph_cache_path.empty() && !this->init_opts.glyph_cache_prewarm_charset.empty()) {
+            job_worker_count = std::max(job_worker_count, 1u);
+        }
+        if (job_worker_count > 0) {
+            jobs::Initialize(job_worker_count);
+        }
+
         if (!this->init_opts.default_shared_fonts.empty() || !this->init_opts.default_font_paths.empty()) {
             TTF_Init();
             this->ttf_init = true;
+            g_MaxFamilyFontCount = this->init_opts.max_loaded_font_sizes;
+
+            AddFontFamily(
+                DefaultFontFamily,
+                [font_paths = this->init_opts.default_font_paths,
+                 shared_fonts = this->init_opts.default_shared_fonts](std::shared_ptr<ttf::Font>& font) {
+                    for (const auto& path : font_paths) {
+                        font->LoadFromFile(path);
+                    }
+                    for (const auto type : shared_fonts) {
+                        LoadSingleSharedFontInFont(font, type);
+                    }
+                    return true;
+                }
+            );
+
+            for (const auto size : this->init_opts.extra_default_font_sizes) {
+                FindFont(MakeDefaultFontName(size));
+            }
+
+            if (this->init_opts.text_render_worker_count > 0) {
+                InitializeTextRenderWorkers(this->init_opts.text_render_worker_count);
+            }
 
-#define _CREATE_DEFAULT_FONT_FOR_SIZES(sizes)                              \
-    {                                                                      \
-        for (const auto size : sizes) {                                    \
-            auto default_font = std::make_shared<ttf::Font>(size);         \
-            for (const auto& path : this->init_opts.default_font_paths) {  \
-                default_font->LoadFromFile(path);                          \
-            }                                                              \
-            for (const auto type : this->init_opts.default_shared_fonts) { \
-                LoadSingleSharedFontInFont(default_font, type);            \
-            }                                                              \
-            AddDefaultFont(default_font);                                  \
-        }                                                                  \
-    }
-
-            _CREATE_DEFAULT_FONT_FOR_SIZES(DefaultFontSizes);
-            _CREATE_DEFAULT_FONT_FOR_SIZES(this->init_opts.extra_default_font_sizes);
+            if (!this->init_opts.glyph_cache_path.empty()) {
+                ttf::LoadGlyphCache(this->init_opts.glyph_cache_path, this->init_opts.glyph_cache_prewarm_charset);
+
+                if (!this->init_opts.glyph_cache_prewarm_charset.empty()) {
+                    ttf::StartGlyphCachePrewarm(GetLoadedDefaultFonts(), this->init_opts.glyph_cache_prewarm_charset);
+                }
+            }
         }
 
         if (this->init_opts.init_mixer) {
             Mix_Init(this->init_opts.audio_mixer_flags);
-            Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, MIX_DEFAULT_CHANNELS, 4096);
+            const auto audio_ok = Mix_OpenAudio(this->init_opts.audio_sample_rate, MIX_DEFAULT_FORMAT, this->init_opts.audio_channel_count, this->init_opts.audio_buffer_sample_count) == 0;
+            if (audio_ok && this->init_opts.audio_latency_measurement) {
+                audio::EnableLatencyMeasurement();
+            }
         }
 
         this->initialized = true;
@@ -90,7 +212,19 @@ void Renderer::Initialize() {
 void Renderer::Finalize() {
     if (this->initialized) {
         // Close all the fonts before closing TTF
+        FinalizeTextRenderWorkers();
+        ttf::StopGlyphCachePrewarm();
+        // Jobs may still use fonts, so they're done before these get closed
+        jobs::Finalize();
+        ttf::SaveGlyphCache();
+        ttf::DisposeGlyphCache();
+        // Anything still alive at this point is destroyed along with the renderer, without going through DeleteTexture
+        ReportTextureLeaks();
+        rmutexLock(&g_FontTableLock);
         g_FontTable.clear();
+        g_FamilyFontList.clear();
+        g_FontFamilyTable.clear();
+        rmutexUnlock(&g_FontTableLock);
 
         if (this->ttf_init) {
             TTF_Quit();
@@ -99,6 +233,7 @@ void Renderer::Finalize() {
             IMG_Quit();
         }
         if (this->init_opts.init_mixer) {
+            audio::DisableLatencyMeasurement();
             Mix_CloseAudio();
         }
         if (this->ok_pl) {
@@ -162,6 +297,59 @@ void Renderer::RenderTexture(sdl2::Texture texture, const i32 x, const i32 y, co
     }
 }
 
+void Renderer::RenderTexture(
+    sdl2::TextureHandle::Ref tex_handle,
+    const i32 x,
+    const i32 y,
+    const TextureRenderOptions opts
+) {
+    if (tex_handle == nullptr) {
+        return;
+    }
+
+    auto level_opts = opts;
+    if (level_opts.width == TextureRenderOptions::NoWidth) {
+        level_opts.width = tex_handle->GetWidth();
+    }
+    if (level_opts.height == TextureRenderOptions::NoHeight) {
+        level_opts.height = tex_handle->GetHeight();
+    }
+    this->RenderTexture(tex_handle->GetFor(level_opts.width, level_opts.height), x, y, level_opts);
+}
+
+void Renderer::RenderTextureRegion(
+    sdl2::Texture texture,
+    const SDL_Rect& src_rect,
+    const i32 x,
+    const i32 y,
+    const i32 width,
+    const i32 height
+) {
+    if (texture == nullptr) {
+        return;
+    }
+
+    const SDL_Rect pos = {.x = x + this->base_x, .y = y + this->base_y, .w = width, .h = height};
+    if (this->base_a >= 0) {
+        SetAlphaValue(texture, static_cast<u8>(this->base_a));
+    }
+
+    SDL_RenderCopy(g_Renderer, texture, &src_rect, &pos);
+
+    if (this->base_a >= 0) {
+        SetAlphaValue(texture, 0xFF);
+    }
+}
+
+void Renderer::SetClipRectangle(const i32 x, const i32 y, const i32 width, const i32 height) {
+    const SDL_Rect rect = {.x = x + this->base_x, .y = y + this->base_y, .w = width, .h = height};
+    SDL_RenderSetClipRect(g_Renderer, &rect);
+}
+
+void Renderer::ResetClipRectangle() {
+    SDL_RenderSetClipRect(g_Renderer, nullptr);
+}
+
 void Renderer::RenderRectangle(const Color clr, const i32 x, const i32 y, const i32 width, const i32 height) {
     const SDL_Rect rect = {.x = x + this->base_x, .y = y + this->base_y, .w = width, .h = height};
     SDL_SetRenderDrawColor(g_Renderer, clr.r, clr.g, clr.b, this->GetActualAlpha(clr.a));
@@ -375,15 +563,43 @@ std::pair<u32, u32> GetDimensions() {
     return {static_cast<u32>(w), static_cast<u32>(h)};
 }
 
+u32 GetDefaultWrapWidth() {
+    return g_DefaultWrapWidth;
+}
+
 bool AddFont(const std::string& font_name, std::shared_ptr<ttf::Font>& font) {
+    rmutexLock(&g_FontTableLock);
     if (ExistsFont(font_name)) {
+        rmutexUnlock(&g_FontTableLock);
         return false;
     }
 
     g_FontTable.push_back(std::make_pair(font_name, std::move(font)));
+    rmutexUnlock(&g_FontTableLock);
+    return true;
+}
+
+bool AddFontFamily(const std::string& font_family, FontFamilyLoadFunction load_fn) {
+    rmutexLock(&g_FontTableLock);
+    for (const auto& [name, _] : g_FontFamilyTable) {
+        if (name == font_family) {
+            rmutexUnlock(&g_FontTableLock);
+            return false;
+        }
+    }
+
+    g_FontFamilyTable.push_back(std::make_pair(font_family, load_fn));
+    rmutexUnlock(&g_FontTableLock);
     return true;
 }
 
+std::shared_ptr<ttf::Font> FindFont(const std::string& font_name) {
+    rmutexLock(&g_FontTableLock);
+    auto font = FindFontImpl(font_name);
+    rmutexUnlock(&g_FontTableLock);
+    return font;
+}
+
 bool LoadSingleSharedFontInFont(std::shared_ptr<ttf::Font>& font, const PlSharedFontType type) {
     // Assume pl services are initialized, and return if anything unexpected happens
     PlFontData data = {};
@@ -409,13 +625,29 @@ bool LoadAllSharedFontsInFont(std::shared_ptr<ttf::Font>& font) {
 }
 
 bool GetTextDimensions(const std::string& font_name, const std::string& text, i32& out_width, i32& out_height) {
-    for (auto& [name, font] : g_FontTable) {
-        if (name == font_name) {
-            const auto [w, h] = font->GetTextDimensions(text);
-            out_width = w;
-            out_height = h;
-            return true;
-        }
+    auto font = FindFont(font_name);
+    if (font != nullptr) {
+        const auto [w, h] = font->GetTextDimensions(text);
+        out_width = w;
+        out_height = h;
+        return true;
+    }
+    return false;
+}
+
+bool GetWrappedTextDimensions(
+    const std::string& font_name,
+    const std::string& text,
+    const u32 wrap_width,
+    i32& out_width,
+    i32& out_height
+) {
+    auto font = FindFont(font_name);
+    if (font != nullptr) {
+        const auto [w, h] = font->GetWrappedTextDimensions(text, wrap_width);
+        out_width = w;
+        out_height = h;
+        return true;
     }
     return false;
 }
@@ -434,45 +666,68 @@ i32 GetTextHeight(const std::string& font_name, const std::string& text) {
     return height;
 }
 
-sdl2::Texture RenderText(
+sdl2::Surface RenderTextSurface(
     const std::string& font_name,
     const std::string& text,
     const Color clr,
     const u32 max_width,
-    const u32 max_height
+    const u32 max_height,
+    const u32 wrap_width
 ) {
-    for (auto& [name, font] : g_FontTable) {
-        if (name == font_name) {
-            auto text_tex = font->RenderText(text, clr);
-
-            if ((max_width > 0) || (max_height > 0)) {
-                auto cur_text = text;
-                auto cur_width = GetTextureWidth(text_tex);
-                auto cur_height = GetTextureHeight(text_tex);
-                while (true) {
-                    if (cur_text.empty()) {
-                        break;
-                    }
-                    if ((max_width > 0) && (cur_width <= (i32)max_width)) {
-                        break;
-                    }
-                    if ((max_height > 0) && (cur_height <= (i32)max_height)) {
-                        break;
-                    }
+    auto font = FindFont(font_name);
+    if (font == nullptr) {
+        return nullptr;
+    }
 
-                    cur_text.pop_back();
-                    DeleteTexture(text_tex);
-                    text_tex = font->RenderText(cur_text + "...", clr);
-                    cur_width = GetTextureWidth(text_tex);
-                    cur_height = GetTextureHeight(text_tex);
-                }
-            }
+    const auto resolved_wrap_width = (wrap_width > 0) ? wrap_width : GetDefaultWrapWidth();
+    if (((max_width == 0) && (max_height == 0)) ||
+        FitsMaxDimensions(font->GetTextDimensions(text), max_width, max_height)) {
+        return font->RenderTextSurface(text, clr, resolved_wrap_width);
+    }
 
-            return text_tex;
+    // Binary search the longest prefix (cut at codepoint boundaries) which still fits with the suffix appended,
+    // only measuring each candidate, so that the text is rasterized just once
+    std::vector<size_t> cut_lengths = {0};
+    for (size_t i = 1; i < text.length(); i++) {
+        if (IsUtf8CodepointStart(text[i])) {
+            cut_lengths.push_back(i);
         }
     }
 
-    return nullptr;
+    std::string cut_text;
+    cut_text.reserve(text.length() + sizeof(TruncatedTextSuffix));
+    const auto make_cut_text = [&](const size_t cut_len) {
+        cut_text.assign(text, 0, cut_len);
+        cut_text.append(TruncatedTextSuffix);
+    };
+
+    // If nothing fits, only the suffix is rendered
+    size_t min_idx = 0;
+    size_t max_idx = cut_lengths.size() - 1;
+    while (min_idx < max_idx) {
+        const auto mid_idx = min_idx + (max_idx - min_idx + 1) / 2;
+        make_cut_text(cut_lengths.at(mid_idx));
+        if (FitsMaxDimensions(font->ComputeTextDimensions(cut_text), max_width, max_height)) {
+            min_idx = mid_idx;
+        } else {
+            max_idx = mid_idx - 1;
+        }
+    }
+
+    make_cut_text(cut_lengths.at(min_idx));
+    return font->RenderTextSurface(cut_text, clr, resolved_wrap_width);
+}
+
+sdl2::Texture RenderText(
+    const std::string& font_name,
+    const std::string& text,
+    const Color clr,
+    const u32 max_width,
+    const u32 max_height,
+    const u32 wrap_width
+) {
+    TextureTagScope tag_scope("RenderText");
+    return ConvertToTexture(RenderTextSurface(font_name, text, clr, max_width, max_height, wrap_width));
 }
 
 }  // namespace pu::ui::render
@@ -1,21 +1,374 @@
 #include <pu/ui/render/render_SDL2.hpp>
 #include <pu/ui/render/render_Renderer.hpp>
+#include <algorithm>
+#include <cstring>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
 
 namespace pu::ui::render {
 
-    sdl2::Texture ConvertToTexture(sdl2::Surface surface) {
+    namespace {
+
+        constexpr i32 MinMipmapSize = 8;
+
+        bool g_PremultipliedAlphaEnabled = false;
+
+        // Exact round(value * factor / 255)
+        inline u8 MultiplyAlpha(const u8 value, const u8 factor) {
+            const u32 tmp = value * factor;
+            return static_cast<u8>((tmp + ((tmp + 0x80) >> 8) + 0x80) >> 8);
+        }
+
+        #ifdef __ARM_NEON
+
+        inline uint8x16_t MultiplyAlpha(const uint8x16_t values, const uint8x16_t factors) {
+            // Same rounding as the scalar version, narrowing with the final (x + 0x80) >> 8
+            const auto tmp_lo = vmull_u8(vget_low_u8(values), vget_low_u8(factors));
+            const auto tmp_hi = vmull_u8(vget_high_u8(values), vget_high_u8(factors));
+            return vcombine_u8(vraddhn_u16(tmp_lo, vrshrq_n_u16(tmp_lo, 8)), vraddhn_u16(tmp_hi, vrshrq_n_u16(tmp_hi, 8)));
+        }
+
+        #endif
+
+        // Row kernels converting into RGBA32, vectorized 16 pixels at a time where NEON is available
+
+        void PremultiplyRowRGBA32(u8 *px, const i32 width) {
+            i32 x = 0;
+            #ifdef __ARM_NEON
+            for(; (x + 16) <= width; x += 16) {
+                auto rgba = vld4q_u8(px + x * 4);
+                rgba.val[0] = MultiplyAlpha(rgba.val[0], rgba.val[3]);
+                rgba.val[1] = MultiplyAlpha(rgba.val[1], rgba.val[3]);
+                rgba.val[2] = MultiplyAlpha(rgba.val[2], rgba.val[3]);
+                vst4q_u8(px + x * 4, rgba);
+            }
+            #endif
+            for(; x < width; x++) {
+                auto cur_px = px + x * 4;
+                cur_px[0] = MultiplyAlpha(cur_px[0], cur_px[3]);
+                cur_px[1] = MultiplyAlpha(cur_px[1], cur_px[3]);
+                cur_px[2] = MultiplyAlpha(cur_px[2], cur_px[3]);
+            }
+        }
+
+        void ConvertRowBGRA32(const u8 *src, u8 *dst, const i32 width) {
+            i32 x = 0;
+            #ifdef __ARM_NEON
+            for(; (x + 16) <= width; x += 16) {
+                auto bgra = vld4q_u8(src + x * 4);
+                std::swap(bgra.val[0], bgra.val[2]);
+                vst4q_u8(dst + x * 4, bgra);
+            }
+            #endif
+            for(; x < width; x++) {
+                dst[x * 4] = src[x * 4 + 2];
+                dst[x * 4 + 1] = src[x * 4 + 1];
+                dst[x * 4 + 2] = src[x * 4];
+                dst[x * 4 + 3] = src[x * 4 + 3];
+            }
+        }
+
+        template<bool SwapRedBlue>
+        void ConvertRow24(const u8 *src, u8 *dst, const i32 width) {
+            i32 x = 0;
+            #ifdef __ARM_NEON
+            for(; (x + 16) <= width; x += 16) {
+                const auto rgb = vld3q_u8(src + x * 3);
+                uint8x16x4_t rgba;
+                rgba.val[0] = SwapRedBlue ? rgb.val[2] : rgb.val[0];
+                rgba.val[1] = rgb.val[1];
+                rgba.val[2] = SwapRedBlue ? rgb.val[0] : rgb.val[2];
+                rgba.val[3] = vdupq_n_u8(0xFF);
+                vst4q_u8(dst + x * 4, rgba);
+            }
+            #endif
+            for(; x < width; x++) {
+                dst[x * 4] = src[x * 3 + (SwapRedBlue ? 2 : 0)];
+                dst[x * 4 + 1] = src[x * 3 + 1];
+                dst[x * 4 + 2] = src[x * 3 + (SwapRedBlue ? 0 : 2)];
+                dst[x * 4 + 3] = 0xFF;
+            }
+        }
+
+        void ConvertRowIndex8(const u8 *src, u8 *dst, const i32 width, const u32 *palette_lut) {
+            // Lookups don't vectorize well with a 256-entry table, but the table already has alpha premultiplied if needed
+            for(i32 x = 0; x < width; x++) {
+                std::memcpy(dst + x * 4, &palette_lut[src[x]], sizeof(u32));
+            }
+        }
+
+        void PremultiplySurface(sdl2::Surface srf) {
+            const auto must_lock = SDL_MUSTLOCK(srf);
+            if(must_lock) {
+                SDL_LockSurface(srf);
+            }
+            for(i32 y = 0; y < srf->h; y++) {
+                PremultiplyRowRGBA32(reinterpret_cast<u8*>(srf->pixels) + y * srf->pitch, srf->w);
+            }
+            if(must_lock) {
+                SDL_UnlockSurface(srf);
+            }
+        }
+
+        sdl2::Texture CreateNormalizedTexture(sdl2::Surface srf) {
+            auto tex = SDL_CreateTextureFromSurface(GetMainRenderer(), srf);
+            if(tex != nullptr) {
+                SDL_SetTextureBlendMode(tex, GetNormalizedBlendMode());
+            }
+            return tex;
+        }
+
+        // 2x2 box filter weighted by alpha, so that transparent pixels don't bleed dark fringes into the edges
+        // Premultiplied pixels are already weighted by alpha, so they're just averaged
+        sdl2::Surface HalveSurface(sdl2::Surface src, const bool premultiplied) {
+            const auto w = std::max(src->w / 2, 1);
+            const auto h = std::max(src->h / 2, 1);
+            auto dst = SDL_CreateRGBSurfaceWithFormat(0, w, h, 32, SDL_PIXELFORMAT_RGBA32);
+            if(dst == nullptr) {
+                return nullptr;
+            }
+
+            const auto src_pixels = reinterpret_cast<const u8*>(src->pixels);
+            auto dst_pixels = reinterpret_cast<u8*>(dst->pixels);
+            for(i32 y = 0; y < h; y++) {
+                const u8 *src_rows[2] = {
+                    src_pixels + std::min(2 * y, src->h - 1) * src->pitch,
+                    src_pixels + std::min(2 * y + 1, src->h - 1) * src->pitch
+                };
+                auto dst_px = dst_pixels + y * dst->pitch;
+                for(i32 x = 0; x < w; x++) {
+                    const i32 src_xs[2] = { std::min(2 * x, src->w - 1), std::min(2 * x + 1, src->w - 1) };
+                    u32 r = 0;
+                    u32 g = 0;
+                    u32 b = 0;
+                    u32 a = 0;
+                    for(const auto src_row : src_rows) {
+                        for(const auto src_x : src_xs) {
+                            const auto src_px = src_row + src_x * 4;
+                            const u32 weight = premultiplied ? 1 : src_px[3];
+                            r += src_px[0] * weight;
+                            g += src_px[1] * weight;
+                            b += src_px[2] * weight;
+                            a += src_px[3];
+                        }
+                    }
+
+                    if(premultiplied) {
+                        dst_px[0] = static_cast<u8>((r + 2) / 4);
+                        dst_px[1] = static_cast<u8>((g + 2) / 4);
+                        dst_px[2] = static_cast<u8>((b + 2) / 4);
+                    }
+                    else if(a > 0) {
+                        dst_px[0] = static_cast<u8>((r + a / 2) / a);
+                        dst_px[1] = static_cast<u8>((g + a / 2) / a);
+                        dst_px[2] = static_cast<u8>((b + a / 2) / a);
+                    }
+                    else {
+                        dst_px[0] = 0;
+                        dst_px[1] = 0;
+                        dst_px[2] = 0;
+                    }
+                    dst_px[3] = static_cast<u8>((a + 2) / 4);
+                    dst_px += 4;
+                }
+            }
+            return dst;
+        }
+
+    }
+
+    void SetPremultipliedAlphaEnabled(const bool enabled) {
+        g_PremultipliedAlphaEnabled = enabled;
+    }
+
+    bool IsPremultipliedAlphaEnabled() {
+        return g_PremultipliedAlphaEnabled;
+    }
+
+    SDL_BlendMode GetNormalizedBlendMode() {
+        if(g_PremultipliedAlphaEnabled) {
+            static const auto premultiplied_blend_mode = SDL_ComposeCustomBlendMode(SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD, SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+            return premultiplied_blend_mode;
+        }
+        else {
+            return SDL_BLENDMODE_BLEND;
+        }
+    }
+
+    sdl2::Surface NormalizeSurface(sdl2::Surface surface) {
         if(surface == nullptr) {
             return nullptr;
         }
 
-        auto tex = SDL_CreateTextureFromSurface(GetMainRenderer(), surface);
+        const auto src_fmt = surface->format->format;
+        // Color keys are only applied here for palettes, other keyed surfaces are left to SDL's conversion
+        const auto has_color_key = (src_fmt != SDL_PIXELFORMAT_INDEX8) && SDL_HasColorKey(surface);
+        if((src_fmt == SDL_PIXELFORMAT_RGBA32) && !has_color_key) {
+            if(g_PremultipliedAlphaEnabled) {
+                PremultiplySurface(surface);
+            }
+            return surface;
+        }
+
+        const auto is_supported_fmt = !has_color_key && ((src_fmt == SDL_PIXELFORMAT_BGRA32) || (src_fmt == SDL_PIXELFORMAT_RGB24) || (src_fmt == SDL_PIXELFORMAT_BGR24) || ((src_fmt == SDL_PIXELFORMAT_INDEX8) && (surface->format->palette != nullptr)));
+        if(!is_supported_fmt) {
+            // Any other format goes through SDL's generic (and way slower) conversion
+            auto normalized = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+            SDL_FreeSurface(surface);
+            if((normalized != nullptr) && g_PremultipliedAlphaEnabled) {
+                PremultiplySurface(normalized);
+            }
+            return normalized;
+        }
+
+        auto normalized = SDL_CreateRGBSurfaceWithFormat(0, surface->w, surface->h, 32, SDL_PIXELFORMAT_RGBA32);
+        if(normalized == nullptr) {
+            SDL_FreeSurface(surface);
+            return nullptr;
+        }
+
+        u32 palette_lut[0x100] = {};
+        if(src_fmt == SDL_PIXELFORMAT_INDEX8) {
+            const auto palette = surface->format->palette;
+            for(i32 i = 0; i < std::min(palette->ncolors, 0x100); i++) {
+                const auto &clr = palette->colors[i];
+                u8 lut_px[4] = { clr.r, clr.g, clr.b, clr.a };
+                if(g_PremultipliedAlphaEnabled) {
+                    lut_px[0] = MultiplyAlpha(lut_px[0], lut_px[3]);
+                    lut_px[1] = MultiplyAlpha(lut_px[1], lut_px[3]);
+                    lut_px[2] = MultiplyAlpha(lut_px[2], lut_px[3]);
+                }
+                std::memcpy(&palette_lut[i], lut_px, sizeof(u32));
+            }
+            u32 color_key = 0;
+            if((SDL_GetColorKey(surface, &color_key) == 0) && (color_key < 0x100)) {
+                palette_lut[color_key] = 0;
+            }
+        }
+
+        const auto must_lock = SDL_MUSTLOCK(surface);
+        if(must_lock) {
+            SDL_LockSurface(surface);
+        }
+        for(i32 y = 0; y < surface->h; y++) {
+            const auto src_row = reinterpret_cast<const u8*>(surface->pixels) + y * surface->pitch;
+            auto dst_row = reinterpret_cast<u8*>(normalized->pixels) + y * normalized->pitch;
+            switch(src_fmt) {
+                case SDL_PIXELFORMAT_BGRA32: {
+                    ConvertRowBGRA32(src_row, dst_row, surface->w);
+                    // Rows are premultiplied right after being converted, while still in cache
+                    if(g_PremultipliedAlphaEnabled) {
+                        PremultiplyRowRGBA32(dst_row, surface->w);
+                    }
+                    break;
+                }
+                // Fully opaque, so there's nothing to premultiply
+                case SDL_PIXELFORMAT_RGB24: {
+                    ConvertRow24<false>(src_row, dst_row, surface->w);
+                    break;
+                }
+                case SDL_PIXELFORMAT_BGR24: {
+                    ConvertRow24<true>(src_row, dst_row, surface->w);
+                    break;
+                }
+                default: {
+                    ConvertRowIndex8(src_row, dst_row, surface->w, palette_lut);
+                    break;
+                }
+            }
+        }
+        if(must_lock) {
+            SDL_UnlockSurface(surface);
+        }
+
+        SDL_FreeSurface(surface);
+        return normalized;
+    }
+
+    sdl2::Texture ConvertNormalizedToTexture(sdl2::Surface surface) {
+        if(surface == nullptr) {
+            return nullptr;
+        }
+
+        auto tex = CreateNormalizedTexture(surface);
         SDL_FreeSurface(surface);
+        TrackTexture(tex, "ConvertToTexture");
         return tex;
     }
 
+    sdl2::Texture ConvertToTexture(sdl2::Surface surface) {
+        return ConvertNormalizedToTexture(NormalizeSurface(surface));
+    }
+
     sdl2::Texture LoadImage(const std::string &path) {
+        TextureTagScope tag_scope("LoadImage");
         return ConvertToTexture(IMG_Load(path.c_str()));
     }
+
+    sdl2::TextureHandle::Ref ConvertToTextureWithMipmaps(sdl2::Surface surface) {
+        if(surface == nullptr) {
+            return nullptr;
+        }
+
+        // Levels are generated here once, so drawing a big image small neither aliases nor samples the whole of it
+        auto level = NormalizeSurface(surface);
+        if(level == nullptr) {
+            return nullptr;
+        }
+
+        auto base_tex = CreateNormalizedTexture(level);
+        TrackTexture(base_tex, "ConvertToTexture");
+        auto tex_handle = sdl2::TextureHandle::New(base_tex);
+        while((level->w > MinMipmapSize) && (level->h > MinMipmapSize)) {
+            auto next_level = HalveSurface(level, g_PremultipliedAlphaEnabled);
+            SDL_FreeSurface(level);
+            level = next_level;
+            if(level == nullptr) {
+                break;
+            }
+            auto level_tex = CreateNormalizedTexture(level);
+            TrackTexture(level_tex, "Mipmap");
+            tex_handle->AddMipmap(level_tex);
+        }
+        if(level != nullptr) {
+            SDL_FreeSurface(level);
+        }
+        return tex_handle;
+    }
+
+    sdl2::TextureHandle::Ref LoadImageWithMipmaps(const std::string &path) {
+        TextureTagScope tag_scope("LoadImageWithMipmaps");
+        return ConvertToTextureWithMipmaps(IMG_Load(path.c_str()));
+    }
+
+    sdl2::Surface ResizeSurface(sdl2::Surface surface, const i32 width, const i32 height) {
+        if((surface == nullptr) || (width <= 0) || (height <= 0)) {
+            return nullptr;
+        }
+
+        auto level = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_RGBA32, 0);
+        while((level != nullptr) && (level->w >= 2 * width) && (level->h >= 2 * height)) {
+            auto next_level = HalveSurface(level, false);
+            SDL_FreeSurface(level);
+            level = next_level;
+        }
+        if(level == nullptr) {
+            return nullptr;
+        }
+        if((level->w == width) && (level->h == height)) {
+            return level;
+        }
+
+        auto resized = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA32);
+        if(resized != nullptr) {
+            SDL_SetSurfaceBlendMode(level, SDL_BLENDMODE_NONE);
+            SDL_BlitScaled(level, nullptr, resized, nullptr);
+        }
+        SDL_FreeSurface(level);
+        return resized;
+    }
     
     i32 GetTextureWidth(sdl2::Texture texture) {
         if(texture == nullptr) {
@@ -42,12 +395,20 @@ namespace pu::ui::render {
             return;
         }
 
-        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        // Premultiplied textures keep their blend mode, and need their color faded along with their alpha
+        SDL_BlendMode blend_mode;
+        if(g_PremultipliedAlphaEnabled && (SDL_GetTextureBlendMode(texture, &blend_mode) == 0) && (blend_mode == GetNormalizedBlendMode())) {
+            SDL_SetTextureColorMod(texture, alpha, alpha, alpha);
+        }
+        else {
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        }
         SDL_SetTextureAlphaMod(texture, alpha);
     }
 
     void DeleteTexture(sdl2::Texture &texture) {
         if(texture != nullptr) {
+            UntrackTexture(texture);
             SDL_DestroyTexture(texture);
             texture = nullptr;
         }
@@ -0,0 +1,136 @@
+#include <pu/ui/render/render_Renderer.hpp>
+#include <pu/jobs/jobs_JobSystem.hpp>
+#include <atomic>
+
+namespace pu::ui::render {
+
+    struct TextTexture::State {
+        RMutex lock;
+        u64 last_request_id;
+        bool has_result;
+        sdl2::Surface result;
+
+        State() : last_request_id(0), has_result(false), result(nullptr) {
+            rmutexInit(&this->lock);
+        }
+
+        ~State() {
+            this->DiscardResult();
+        }
+
+        u64 NewRequest() {
+            rmutexLock(&this->lock);
+            const auto req_id = ++this->last_request_id;
+            rmutexUnlock(&this->lock);
+            return req_id;
+        }
+
+        bool IsLatestRequest(const u64 req_id) {
+            rmutexLock(&this->lock);
+            const auto is_latest = req_id == this->last_request_id;
+            rmutexUnlock(&this->lock);
+            return is_latest;
+        }
+
+        void SetResult(const u64 req_id, sdl2::Surface srf) {
+            rmutexLock(&this->lock);
+            if(req_id == this->last_request_id) {
+                if(this->result != nullptr) {
+                    SDL_FreeSurface(this->result);
+                }
+                this->has_result = true;
+                this->result = srf;
+                srf = nullptr;
+            }
+            rmutexUnlock(&this->lock);
+
+            // A newer request was made while this one was being rasterized
+            if(srf != nullptr) {
+                SDL_FreeSurface(srf);
+            }
+        }
+
+        bool TakeResult(sdl2::Surface &out_srf) {
+            rmutexLock(&this->lock);
+            const auto has_result = this->has_result;
+            if(has_result) {
+                out_srf = this->result;
+                this->has_result = false;
+                this->result = nullptr;
+            }
+            rmutexUnlock(&this->lock);
+            return has_result;
+        }
+
+        void DiscardResult() {
+            sdl2::Surface srf = nullptr;
+            if(this->TakeResult(srf) && (srf != nullptr)) {
+                SDL_FreeSurface(srf);
+            }
+        }
+    };
+
+    namespace {
+
+        std::atomic_bool g_AsyncTextRenderingEnabled = false;
+
+    }
+
+    bool InitializeTextRenderWorkers(const u32 worker_count) {
+        // Rasterization runs as jobs, so the worker count only matters if the job system isn't running yet
+        g_AsyncTextRenderingEnabled = jobs::Initialize(worker_count);
+        return g_AsyncTextRenderingEnabled;
+    }
+
+    void FinalizeTextRenderWorkers() {
+        // Later requests are rasterized right away again, jobs still queued are left to the job system
+        g_AsyncTextRenderingEnabled = false;
+    }
+
+    bool IsAsyncTextRenderingEnabled() {
+        return g_AsyncTextRenderingEnabled;
+    }
+
+    TextTexture::TextTexture() : state(std::make_shared<State>()), tex(nullptr) {}
+
+    TextTexture::~TextTexture() {
+        // Queued jobs keep the state alive, but are skipped since their request is no longer the latest
+        this->state->NewRequest();
+        DeleteTexture(this->tex);
+    }
+
+    void TextTexture::Request(const std::string &font_name, const std::string &text, const Color clr, const u32 max_width, const u32 max_height, const u32 wrap_width) {
+        const auto req_id = this->state->NewRequest();
+        if(IsAsyncTextRenderingEnabled()) {
+            // Visible text is waited for, so it goes ahead of other background work
+            jobs::Submit([state = this->state, req_id, font_name, text, clr, max_width, max_height, wrap_width]() {
+                // Requests superseded while queued are skipped, so repeatedly updated text doesn't pile up work
+                if(state->IsLatestRequest(req_id)) {
+                    // Also converted here, so that the render thread only has to upload it
+                    state->SetResult(req_id, NormalizeSurface(RenderTextSurface(font_name, text, clr, max_width, max_height, wrap_width)));
+                }
+            }, {}, jobs::JobPriority::High);
+        }
+        else {
+            this->state->SetResult(req_id, NormalizeSurface(RenderTextSurface(font_name, text, clr, max_width, max_height, wrap_width)));
+        }
+    }
+
+    sdl2::Texture TextTexture::Get() {
+        sdl2::Surface srf = nullptr;
+        if(this->state->TakeResult(srf)) {
+            TextureTagScope tag_scope("TextTexture");
+            DeleteTexture(this->tex);
+            this->tex = ConvertNormalizedToTexture(srf);
+        }
+        return this->tex;
+    }
+
+    void TextTexture::Clear() {
+        // Also makes any request in flight stale
+        this->state->NewRequest();
+        this->state->DiscardResult();
+        DeleteTexture(this->tex);
+    }
+
+}
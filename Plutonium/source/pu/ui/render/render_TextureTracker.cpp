@@ -0,0 +1,171 @@
+#include <pu/ui/render/render_TextureTracker.hpp>
+#include <unordered_map>
+#include <map>
+
+namespace pu::ui::render {
+
+    namespace {
+
+        struct TrackedTexture {
+            const char *tag;
+            const void *owner;
+            size_t byte_size;
+        };
+
+        RMutex g_TrackerLock = {};
+        std::unordered_map<sdl2::Texture, TrackedTexture> g_TrackedTextures;
+        size_t g_LiveTextureBytes = 0;
+        size_t g_TextureBudgetBytes = 0;
+        TextureBudgetCallback g_TextureBudgetCallback;
+        TextureLeakReportCallback g_TextureLeakReportCallback;
+
+        thread_local const char *g_CurrentTag = nullptr;
+        thread_local const void *g_CurrentOwner = nullptr;
+
+        size_t ComputeTextureByteSize(sdl2::Texture tex) {
+            u32 fmt = SDL_PIXELFORMAT_UNKNOWN;
+            i32 w = 0;
+            i32 h = 0;
+            if(SDL_QueryTexture(tex, &fmt, nullptr, &w, &h) != 0) {
+                return 0;
+            }
+
+            // Planar YUV formats take a full-size luma plane plus quarter-size chroma ones
+            if(SDL_ISPIXELFORMAT_FOURCC(fmt)) {
+                return (static_cast<size_t>(w) * h * 3) / 2;
+            }
+            return static_cast<size_t>(w) * h * SDL_BYTESPERPIXEL(fmt);
+        }
+
+    }
+
+    void TrackTexture(sdl2::Texture tex, const char *tag) {
+        if(tex == nullptr) {
+            return;
+        }
+
+        const auto byte_size = ComputeTextureByteSize(tex);
+        rmutexLock(&g_TrackerLock);
+        auto &tracked_tex = g_TrackedTextures[tex];
+        g_LiveTextureBytes -= tracked_tex.byte_size;
+        tracked_tex = { (g_CurrentTag != nullptr) ? g_CurrentTag : tag, g_CurrentOwner, byte_size };
+        g_LiveTextureBytes += byte_size;
+
+        const auto live_bytes = g_LiveTextureBytes;
+        const auto budget_bytes = g_TextureBudgetBytes;
+        const auto over_budget = (budget_bytes > 0) && (live_bytes > budget_bytes);
+        auto budget_cb = over_budget ? g_TextureBudgetCallback : TextureBudgetCallback();
+        rmutexUnlock(&g_TrackerLock);
+
+        if(budget_cb) {
+            budget_cb(live_bytes, budget_bytes);
+        }
+    }
+
+    void UntrackTexture(sdl2::Texture tex) {
+        rmutexLock(&g_TrackerLock);
+        auto it = g_TrackedTextures.find(tex);
+        if(it != g_TrackedTextures.end()) {
+            g_LiveTextureBytes -= it->second.byte_size;
+            g_TrackedTextures.erase(it);
+        }
+        rmutexUnlock(&g_TrackerLock);
+    }
+
+    void SetTextureOwner(sdl2::Texture tex, const void *owner) {
+        rmutexLock(&g_TrackerLock);
+        auto it = g_TrackedTextures.find(tex);
+        if(it != g_TrackedTextures.end()) {
+            it->second.owner = owner;
+        }
+        rmutexUnlock(&g_TrackerLock);
+    }
+
+    size_t GetLiveTextureBytes() {
+        rmutexLock(&g_TrackerLock);
+        const auto live_bytes = g_LiveTextureBytes;
+        rmutexUnlock(&g_TrackerLock);
+        return live_bytes;
+    }
+
+    u32 GetLiveTextureCount() {
+        rmutexLock(&g_TrackerLock);
+        const auto live_count = static_cast<u32>(g_TrackedTextures.size());
+        rmutexUnlock(&g_TrackerLock);
+        return live_count;
+    }
+
+    std::vector<TextureTagUsage> GetTextureUsageByTag() {
+        std::map<std::string, TextureTagUsage> usage_table;
+        rmutexLock(&g_TrackerLock);
+        for(const auto &[tex, tracked_tex] : g_TrackedTextures) {
+            auto &usage = usage_table[tracked_tex.tag];
+            usage.tag = tracked_tex.tag;
+            usage.tex_count++;
+            usage.byte_size += tracked_tex.byte_size;
+        }
+        rmutexUnlock(&g_TrackerLock);
+
+        std::vector<TextureTagUsage> usages;
+        usages.reserve(usage_table.size());
+        for(const auto &[tag, usage] : usage_table) {
+            usages.push_back(usage);
+        }
+        return usages;
+    }
+
+    std::vector<TrackedTextureInfo> GetTrackedTextures() {
+        std::vector<TrackedTextureInfo> tex_infos;
+        rmutexLock(&g_TrackerLock);
+        tex_infos.reserve(g_TrackedTextures.size());
+        for(const auto &[tex, tracked_tex] : g_TrackedTextures) {
+            tex_infos.push_back({ tex, tracked_tex.tag, tracked_tex.owner, tracked_tex.byte_size });
+        }
+        rmutexUnlock(&g_TrackerLock);
+        return tex_infos;
+    }
+
+    void SetTextureBudget(const size_t budget_bytes, TextureBudgetCallback budget_cb) {
+        rmutexLock(&g_TrackerLock);
+        g_TextureBudgetBytes = budget_bytes;
+        g_TextureBudgetCallback = budget_cb;
+        rmutexUnlock(&g_TrackerLock);
+    }
+
+    void SetTextureLeakReportCallback(TextureLeakReportCallback leak_report_cb) {
+        rmutexLock(&g_TrackerLock);
+        g_TextureLeakReportCallback = leak_report_cb;
+        rmutexUnlock(&g_TrackerLock);
+    }
+
+    void ReportTextureLeaks() {
+        const auto leaked_texs = GetTrackedTextures();
+
+        rmutexLock(&g_TrackerLock);
+        auto leak_report_cb = g_TextureLeakReportCallback;
+        g_TrackedTextures.clear();
+        g_LiveTextureBytes = 0;
+        rmutexUnlock(&g_TrackerLock);
+
+        if(leak_report_cb && !leaked_texs.empty()) {
+            leak_report_cb(leaked_texs);
+        }
+    }
+
+    TextureTagScope::TextureTagScope(const char *tag) : prev_tag(g_CurrentTag) {
+        g_CurrentTag = tag;
+    }
+
+    TextureTagScope::~TextureTagScope() {
+        g_CurrentTag = this->prev_tag;
+    }
+
+    TextureOwnerScope::TextureOwnerScope(const void *owner) : prev_owner(g_CurrentOwner) {
+        g_CurrentOwner = owner;
+    }
+
+    TextureOwnerScope::~TextureOwnerScope() {
+        g_CurrentOwner = this->prev_owner;
+    }
+
+}
@@ -1,4 +1,5 @@
 #include <pu/ui/ui_Application.hpp>
+#include <pu/jobs/jobs_JobSystem.hpp>
 
 namespace pu::ui {
 
@@ -19,6 +20,9 @@ namespace pu::ui {
         this->fade_bg_tex = {};
         this->fade_bg_clr = { 0, 0, 0, 0xFF };
         rmutexInit(&this->render_lock);
+        this->render_depth = 0;
+        this->close_pending = false;
+        this->close_pending_exit = false;
     }
 
     Application::~Application() {
@@ -97,6 +101,7 @@ namespace pu::ui {
         }
 
         auto continue_render = true;
+        this->render_depth++;
         this->renderer->InitializeRender(this->lyt->GetBackgroundColor());
         this->OnRender();
         if(this->in_render_over) {
@@ -105,6 +110,12 @@ namespace pu::ui {
             this->render_over_fn = {};
         }
         this->renderer->FinalizeRender();
+        this->render_depth--;
+
+        if(this->close_pending && (this->render_depth == 0)) {
+            this->close_pending = false;
+            this->Close(this->close_pending_exit);
+        }
         return continue_render;
     }
 
@@ -154,6 +165,8 @@ namespace pu::ui {
 
     void Application::OnRender() {
         this->LockRender();
+        // Results of finished background work are handed over before anything else this frame
+        jobs::RunContinuations();
         this->renderer->UpdateInput();
         const auto keys_down = this->GetButtonsDown();
         const auto keys_up = this->GetButtonsUp();
@@ -168,6 +181,14 @@ namespace pu::ui {
             } \
         }
 
+        // Closing from a callback releases the layout, nothing else gets rendered this frame
+        #define _STOP_IF_CLOSED() { \
+            if(this->lyt == nullptr) { \
+                this->UnlockRender(); \
+                return; \
+            } \
+        }
+
         const auto tch_state = this->GetTouchState();
         TouchPoint tch_pos = {};
         if(tch_state.count > 0) {
@@ -190,6 +211,10 @@ namespace pu::ui {
             }
         }
 
+        _STOP_IF_CLOSED();
+
+        // Textures created while rendering are attributed to the layout, or to the element being rendered
+        render::TextureOwnerScope lyt_owner_scope(this->lyt.get());
         this->lyt->PreRender();
 
         for(auto &lyt_render_cb: this->lyt->GetRenderCallbacks()) {
@@ -208,9 +233,10 @@ namespace pu::ui {
             }
         }
 
+        _STOP_IF_CLOSED();
         auto lyt_bg_tex = this->lyt->GetBackgroundImageTexture();
         if(lyt_bg_tex != nullptr) {
-            this->renderer->RenderTexture(lyt_bg_tex->Get(), 0, 0);
+            this->renderer->RenderTexture(lyt_bg_tex, 0, 0);
         }
 
         if(!this->in_render_over) {
@@ -222,10 +248,12 @@ namespace pu::ui {
             }
         }
 
+        _STOP_IF_CLOSED();
         auto lyt_elems = this->lyt->GetElements();
         for(auto &elem: lyt_elems) {
             _ONLY_DO_UNCHANGED(
                 if(elem->IsVisible()) {
+                    render::TextureOwnerScope elem_owner_scope(elem.get());
                     elem->OnRender(this->renderer, elem->GetProcessedX(), elem->GetProcessedY());
                     if(!this->in_render_over) {
                         elem->OnInput(keys_down, keys_up, keys_held, tch_pos);
@@ -235,12 +263,14 @@ namespace pu::ui {
         }
 
         if(this->ovl != nullptr) {
-            const auto ovl_continue_render = this->ovl->Render(this->renderer);
+            // Kept alive here, since the overlay may close the app while rendering
+            auto ovl = this->ovl;
+            const auto ovl_continue_render = ovl->Render(this->renderer);
             if(this->ovl_timeout_ms > 0) {
                 const auto time_now = std::chrono::steady_clock::now();
                 const u64 elapsed_time_ms = std::chrono::duration_cast<std::chrono::milliseconds>(time_now - this->ovl_start_time).count();
                 if(elapsed_time_ms >= this->ovl_timeout_ms) {
-                    this->ovl->NotifyEnding(true);
+                    ovl->NotifyEnding(true);
                 }
             }
             if(!ovl_continue_render) {
@@ -251,7 +281,7 @@ namespace pu::ui {
         const auto over_alpha = static_cast<u8>(0xFF - this->fade_alpha);
         if(over_alpha > 0) {
             if(this->fade_bg_tex != nullptr) {
-                this->renderer->RenderTexture(this->fade_bg_tex->Get(), 0, 0, render::TextureRenderOptions::WithCustomAlpha(over_alpha));
+                this->renderer->RenderTexture(this->fade_bg_tex, 0, 0, render::TextureRenderOptions::WithCustomAlpha(over_alpha));
             }
             else {
                 this->renderer->RenderRectangleFill(this->fade_bg_clr.WithAlpha(over_alpha), 0, 0, render::ScreenWidth, render::ScreenHeight);
@@ -263,6 +293,18 @@ namespace pu::ui {
 
     void Application::Close(const bool do_exit) {
         this->is_shown = false;
+        // Released first, so that only textures actually leaked get reported when finalizing
+        this->ovl = nullptr;
+        this->lyt = nullptr;
+        this->fade_bg_tex = {};
+
+        // The frame being rendered still holds the layout and its elements
+        if(this->render_depth > 0) {
+            this->close_pending = true;
+            this->close_pending_exit = this->close_pending_exit || do_exit;
+            return;
+        }
+
         this->renderer->Finalize();
 
         if(do_exit) {
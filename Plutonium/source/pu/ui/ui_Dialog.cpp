@@ -143,12 +143,12 @@ namespace pu::ui {
         auto opt_base_y = title_cnt_height;
     
         if(this->HasIcon()) {
-            const auto icon_height = render::GetTextureHeight(this->icon_tex->Get()) + 2 * this->icon_margin;
+            const auto icon_height = this->icon_tex->GetHeight() + 2 * this->icon_margin;
             if(icon_height > opt_base_y) {
                 opt_base_y = icon_height;
             }
 
-            const auto icon_width = render::GetTextureWidth(this->icon_tex->Get()) + 2 * this->icon_margin;
+            const auto icon_width = this->icon_tex->GetWidth() + 2 * this->icon_margin;
 
             const auto icon_title_width = title_width + icon_width;
             if(icon_title_width > dialog_width) {
@@ -269,10 +269,10 @@ namespace pu::ui {
                 drawer->RenderTexture(this->cnt_tex, dialog_x + this->cnt_x, dialog_y + this->cnt_y);
                 
                 if(this->HasIcon()) {
-                    const auto icon_width = render::GetTextureWidth(this->icon_tex->Get());
+                    const auto icon_width = this->icon_tex->GetWidth();
                     const auto icon_x = dialog_x + (dialog_width - (icon_width + 2 * this->icon_margin));
                     const auto icon_y = dialog_y + this->icon_margin;
-                    drawer->RenderTexture(this->icon_tex->Get(), icon_x, icon_y, render::TextureRenderOptions::WithCustomAlpha(static_cast<u8>(initial_fade_alpha)));
+                    drawer->RenderTexture(this->icon_tex, icon_x, icon_y, render::TextureRenderOptions::WithCustomAlpha(static_cast<u8>(initial_fade_alpha)));
                 }
 
                 auto cur_opt_x = dialog_x + this->opts_base_h_margin;
@@ -0,0 +1,167 @@
+// Host test: VideoFrameSink's buffer exchange, driven by a synthetic producer thread pushing frames like PushFrame
+// and a consumer rendering them like OnRender, checking the pushed/shown/dropped/late counts and that frames are never torn
+
+#include <pu/ui/elm/elm_TripleBufferExchange.hpp>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace {
+
+    using Clock = std::chrono::steady_clock;
+
+    // Every value of a frame holds its number, so a buffer written while being read shows up as mixed values
+    constexpr u32 FrameValueCount = 0x400;
+    constexpr s64 LateThresholdUs = 33333;
+
+    struct FrameBuffer {
+        std::array<u64, FrameValueCount> values;
+        Clock::time_point push_time;
+    };
+
+    struct FrameStatistics {
+        u64 pushed_count;
+        u64 shown_count;
+        u64 dropped_count;
+        u64 late_count;
+    };
+
+    // Same accounting as VideoFrameSink, without the copies and the texture
+    class FrameSink {
+        private:
+            std::array<FrameBuffer, pu::ui::elm::TripleBufferExchange::BufferCount> frame_bufs;
+            pu::ui::elm::TripleBufferExchange buf_exchange;
+            u64 last_shown_frame;
+            bool has_frame;
+
+        public:
+            FrameStatistics stats;
+            bool torn_frame;
+            bool out_of_order_frame;
+
+            FrameSink() : frame_bufs(), buf_exchange(), last_shown_frame(0), has_frame(false), stats(), torn_frame(false), out_of_order_frame(false) {}
+
+            void PushFrame(const u64 frame) {
+                auto &frame_buf = this->frame_bufs.at(this->buf_exchange.GetWriteIndex());
+                frame_buf.values.fill(frame);
+                frame_buf.push_time = Clock::now();
+
+                this->stats.pushed_count++;
+                if(this->buf_exchange.Publish()) {
+                    this->stats.dropped_count++;
+                }
+            }
+
+            // Returns whether a new frame was shown
+            bool Render() {
+                if(!this->buf_exchange.Acquire()) {
+                    return false;
+                }
+
+                const auto &frame_buf = this->frame_bufs.at(this->buf_exchange.GetReadIndex());
+                const auto frame = frame_buf.values.front();
+                for(const auto value : frame_buf.values) {
+                    if(value != frame) {
+                        this->torn_frame = true;
+                    }
+                }
+                if(this->has_frame && (frame <= this->last_shown_frame)) {
+                    this->out_of_order_frame = true;
+                }
+                this->last_shown_frame = frame;
+                this->has_frame = true;
+
+                this->stats.shown_count++;
+                const auto latency_us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - frame_buf.push_time).count();
+                if(latency_us > LateThresholdUs) {
+                    this->stats.late_count++;
+                }
+                return true;
+            }
+
+            inline u64 GetLastShownFrame() {
+                return this->last_shown_frame;
+            }
+    };
+
+    bool g_Failed = false;
+
+    void Check(const bool cond, const char *desc) {
+        if(!cond) {
+            std::printf("FAILED: %s\n", desc);
+            g_Failed = true;
+        }
+    }
+
+    void TestSequential() {
+        FrameSink sink;
+        Check(!sink.Render(), "nothing is shown before any frame is pushed");
+
+        sink.PushFrame(1);
+        Check(sink.Render(), "a pushed frame is shown");
+        Check(sink.GetLastShownFrame() == 1, "the pushed frame is the one shown");
+        Check(!sink.Render(), "a frame is only shown once");
+
+        // Only the latest of several frames pushed between renders is shown, the rest are dropped
+        sink.PushFrame(2);
+        sink.PushFrame(3);
+        sink.PushFrame(4);
+        Check(sink.Render(), "the latest frame is shown");
+        Check(sink.GetLastShownFrame() == 4, "frames replaced before rendering are skipped");
+
+        // Shown too long after being pushed
+        sink.PushFrame(5);
+        std::this_thread::sleep_for(std::chrono::microseconds(LateThresholdUs * 2));
+        Check(sink.Render(), "a late frame is still shown");
+
+        Check(sink.stats.pushed_count == 5, "sequential pushed count");
+        Check(sink.stats.shown_count == 3, "sequential shown count");
+        Check(sink.stats.dropped_count == 2, "sequential dropped count");
+        Check(sink.stats.late_count == 1, "sequential late count");
+        Check(!sink.torn_frame && !sink.out_of_order_frame, "sequential frames are intact and in order");
+    }
+
+    void TestConcurrent(const u64 frame_count, const std::chrono::microseconds push_interval, const std::chrono::microseconds render_interval) {
+        FrameSink sink;
+        std::atomic_bool producer_done = false;
+        std::thread producer([&]() {
+            for(u64 i = 1; i <= frame_count; i++) {
+                sink.PushFrame(i);
+                std::this_thread::sleep_for(push_interval);
+            }
+            producer_done = true;
+        });
+
+        while(!producer_done) {
+            sink.Render();
+            std::this_thread::sleep_for(render_interval);
+        }
+        producer.join();
+        // The last frame is always shown eventually
+        sink.Render();
+
+        std::printf("%llu frames pushed every %lld us, rendered every %lld us: %llu shown, %llu dropped, %llu late\n", static_cast<unsigned long long>(frame_count), static_cast<long long>(push_interval.count()), static_cast<long long>(render_interval.count()), static_cast<unsigned long long>(sink.stats.shown_count), static_cast<unsigned long long>(sink.stats.dropped_count), static_cast<unsigned long long>(sink.stats.late_count));
+        Check(sink.stats.pushed_count == frame_count, "concurrent pushed count");
+        Check((sink.stats.shown_count + sink.stats.dropped_count) == frame_count, "every pushed frame is either shown or dropped");
+        Check(sink.stats.late_count <= sink.stats.shown_count, "only shown frames are late");
+        Check(sink.GetLastShownFrame() == frame_count, "the last pushed frame is shown");
+        Check(!sink.torn_frame, "no frame is read while being written");
+        Check(!sink.out_of_order_frame, "frames are shown in the order they were pushed");
+    }
+
+}
+
+int main() {
+    TestSequential();
+    // Producer faster than the renderer (frames get dropped), slower, and both as fast as possible
+    TestConcurrent(2000, std::chrono::microseconds(100), std::chrono::microseconds(1000));
+    TestConcurrent(300, std::chrono::microseconds(1000), std::chrono::microseconds(100));
+    TestConcurrent(200000, std::chrono::microseconds(0), std::chrono::microseconds(0));
+
+    if(g_Failed) {
+        return 1;
+    }
+    std::printf("TripleBufferExchange matches the expected frame statistics\n");
+    return 0;
+}